@@ -0,0 +1,325 @@
+#include "animated_output.hpp"
+#include "color_math.hpp"
+#include "trace.hpp"
+#include <zlib.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef HAVE_LIBWEBP
+#include <webp/encode.h>
+#include <webp/mux.h>
+#endif
+
+bool AnimWriter::addFrame(cairo_surface_t* frame, int delay_ms) {
+    if (!frame || cairo_image_surface_get_format(frame) != CAIRO_FORMAT_ARGB32) return false;
+    TRACE_SCOPE("anim.encode_frame");
+    TRACE_BYTES((uint64_t)cairo_image_surface_get_stride(frame) * cairo_image_surface_get_height(frame));
+    cairo_surface_flush(frame);
+    return addFrame(reinterpret_cast<const uint32_t*>(cairo_image_surface_get_data(frame)),
+                    cairo_image_surface_get_stride(frame), delay_ms);
+}
+
+// Premultiplied ARGB32 row -> straight RGBA bytes
+static void argb32_row_to_rgba(const uint32_t* src, int n, uint8_t* dst, std::vector<uint32_t>& tmp) {
+    tmp.assign(src, src + n);
+    unpremultiply_argb32_inplace(tmp.data(), (size_t)n);
+    for (int x = 0; x < n; ++x) {
+        const uint32_t p = tmp[x];
+        dst[4*x + 0] = (p >> 16) & 0xFF;
+        dst[4*x + 1] = (p >> 8) & 0xFF;
+        dst[4*x + 2] = p & 0xFF;
+        dst[4*x + 3] = p >> 24;
+    }
+}
+
+// ---------- APNG ----------
+class ApngWriter : public AnimWriter {
+public:
+    ~ApngWriter() override { if (out_.is_open()) close(); }
+
+    bool open(const std::string& path, int width, int height) override {
+        out_.open(path, std::ios::binary | std::ios::trunc);
+        if (!out_) { std::cerr << "Cannot open " << path << "\n"; return false; }
+        path_ = path;
+        w_ = width; h_ = height;
+        prev_.assign((size_t)w_ * h_, 0);
+
+        static const uint8_t sig[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        out_.write(reinterpret_cast<const char*>(sig), 8);
+
+        std::vector<uint8_t> ihdr;
+        put32(ihdr, (uint32_t)w_); put32(ihdr, (uint32_t)h_);
+        ihdr.push_back(8);   // bit depth
+        ihdr.push_back(6);   // RGBA
+        ihdr.push_back(0); ihdr.push_back(0); ihdr.push_back(0);
+        writeChunk("IHDR", ihdr);
+
+        // Frame count is patched in close()
+        actl_pos_ = out_.tellp();
+        writeChunk("acTL", actlData());
+        return (bool)out_;
+    }
+
+    bool addFrame(const uint32_t* pixels, int stride_bytes, int delay_ms) override {
+        if (!out_) return false;
+        const int stride = stride_bytes / 4;
+
+        // Bounding box of pixels that differ from the previous frame
+        int x0 = w_, y0 = h_, x1 = -1, y1 = -1;
+        if (frames_ == 0 && !pending_) {
+            x0 = 0; y0 = 0; x1 = w_ - 1; y1 = h_ - 1;
+        } else {
+            for (int y = 0; y < h_; ++y) {
+                const uint32_t* row = pixels + (size_t)y * stride;
+                const uint32_t* old = &prev_[(size_t)y * w_];
+                if (std::memcmp(row, old, (size_t)w_ * 4) == 0) continue;
+                int l = 0, r = w_ - 1;
+                while (row[l] == old[l]) ++l;
+                while (row[r] == old[r]) --r;
+                x0 = std::min(x0, l); x1 = std::max(x1, r);
+                y0 = std::min(y0, y); y1 = y;
+            }
+        }
+
+        if (x1 < 0 && pending_ && pending_->delay_ms + delay_ms <= 65535) {
+            pending_->delay_ms += delay_ms;   // nothing changed: hold the last frame longer
+            return true;
+        }
+        if (x1 < 0) { x0 = y0 = x1 = y1 = 0; }  // delay overflow: re-emit one unchanged pixel
+
+        if (!flushPending()) return false;
+
+        for (int y = 0; y < h_; ++y)
+            std::memcpy(&prev_[(size_t)y * w_], pixels + (size_t)y * stride, (size_t)w_ * 4);
+
+        Frame f;
+        f.x = x0; f.y = y0; f.w = x1 - x0 + 1; f.h = y1 - y0 + 1;
+        f.delay_ms = delay_ms;
+        if (!compressRegion(f)) return false;
+        pending_.reset(new Frame(std::move(f)));
+        return true;
+    }
+
+    bool close() override {
+        if (!out_.is_open()) return false;
+        bool ok = flushPending();
+        if (frames_ == 0) {
+            // A PNG needs at least one IDAT; don't leave a broken file behind
+            std::cerr << "APNG: no frames written to " << path_ << "\n";
+            out_.close();
+            std::remove(path_.c_str());
+            return false;
+        }
+        writeChunk("IEND", {});
+
+        // Now that the frame count is known, rewrite acTL in place
+        out_.seekp(actl_pos_);
+        writeChunk("acTL", actlData());
+        ok = ok && (bool)out_;
+        out_.close();
+        return ok;
+    }
+
+private:
+    struct Frame {
+        int x = 0, y = 0, w = 0, h = 0;
+        int delay_ms = 0;
+        std::vector<uint8_t> zdata;
+    };
+
+    static void put32(std::vector<uint8_t>& v, uint32_t x) {
+        v.push_back(x >> 24); v.push_back(x >> 16); v.push_back(x >> 8); v.push_back(x);
+    }
+    static void put16(std::vector<uint8_t>& v, uint16_t x) { v.push_back(x >> 8); v.push_back(x); }
+
+    std::vector<uint8_t> actlData() const {
+        std::vector<uint8_t> d;
+        put32(d, (uint32_t)frames_);
+        put32(d, 1);  // play once; a countdown shouldn't loop
+        return d;
+    }
+
+    void writeChunk(const char type[4], const std::vector<uint8_t>& data) {
+        uint8_t len[4] = { (uint8_t)(data.size() >> 24), (uint8_t)(data.size() >> 16),
+                           (uint8_t)(data.size() >> 8), (uint8_t)data.size() };
+        out_.write(reinterpret_cast<const char*>(len), 4);
+        out_.write(type, 4);
+        if (!data.empty()) out_.write(reinterpret_cast<const char*>(data.data()), data.size());
+        uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(type), 4);
+        if (!data.empty()) crc = crc32(crc, data.data(), (uInt)data.size());
+        uint8_t c[4] = { (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc };
+        out_.write(reinterpret_cast<const char*>(c), 4);
+    }
+
+    // Filter each row of the region (cheapest of None/Sub/Up/Paeth) and deflate it
+    bool compressRegion(Frame& f) {
+        const size_t row_bytes = (size_t)f.w * 4;
+        std::vector<uint8_t> raw((row_bytes + 1) * f.h);
+        std::vector<uint8_t> cur(row_bytes), up(row_bytes, 0), cand(row_bytes), best(row_bytes);
+        std::vector<uint32_t> tmp;
+
+        for (int y = 0; y < f.h; ++y) {
+            argb32_row_to_rgba(&prev_[(size_t)(f.y + y) * w_ + f.x], f.w, cur.data(), tmp);
+
+            uint8_t best_type = 0;
+            uint64_t best_cost = UINT64_MAX;
+            for (uint8_t type = 0; type < 5; ++type) {
+                if (type == 3) continue;  // Average rarely wins on flat UI art
+                uint64_t cost = 0;
+                for (size_t i = 0; i < row_bytes; ++i) {
+                    const int a = i >= 4 ? cur[i - 4] : 0;
+                    const int b = up[i];
+                    const int c = i >= 4 ? up[i - 4] : 0;
+                    int pred = 0;
+                    if (type == 1) pred = a;
+                    else if (type == 2) pred = b;
+                    else if (type == 4) {
+                        const int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                        pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                    }
+                    cand[i] = (uint8_t)(cur[i] - pred);
+                    cost += (cand[i] < 128) ? cand[i] : 256 - cand[i];
+                }
+                if (cost < best_cost) { best_cost = cost; best_type = type; best.swap(cand); }
+            }
+
+            uint8_t* dst = &raw[(row_bytes + 1) * y];
+            dst[0] = best_type;
+            std::memcpy(dst + 1, best.data(), row_bytes);
+            up.swap(cur);
+        }
+
+        uLongf zlen = compressBound((uLong)raw.size());
+        f.zdata.resize(zlen);
+        if (compress2(f.zdata.data(), &zlen, raw.data(), (uLong)raw.size(), 6) != Z_OK) {
+            std::cerr << "APNG: deflate failed\n";
+            return false;
+        }
+        f.zdata.resize(zlen);
+        return true;
+    }
+
+    bool flushPending() {
+        if (!pending_) return true;
+        const Frame& f = *pending_;
+
+        std::vector<uint8_t> fctl;
+        put32(fctl, seq_++);
+        put32(fctl, (uint32_t)f.w); put32(fctl, (uint32_t)f.h);
+        put32(fctl, (uint32_t)f.x); put32(fctl, (uint32_t)f.y);
+        put16(fctl, (uint16_t)f.delay_ms); put16(fctl, 1000);
+        fctl.push_back(0);  // dispose_op NONE: next frame starts from this one
+        fctl.push_back(0);  // blend_op SOURCE: region replaces what was there
+        writeChunk("fcTL", fctl);
+
+        if (frames_ == 0) {
+            writeChunk("IDAT", f.zdata);  // first frame doubles as the default image
+        } else {
+            std::vector<uint8_t> fdat;
+            fdat.reserve(f.zdata.size() + 4);
+            put32(fdat, seq_++);
+            fdat.insert(fdat.end(), f.zdata.begin(), f.zdata.end());
+            writeChunk("fdAT", fdat);
+        }
+        ++frames_;
+        pending_.reset();
+        return (bool)out_;
+    }
+
+    std::ofstream out_;
+    std::string path_;
+    std::streampos actl_pos_{};
+    int w_ = 0, h_ = 0;
+    uint32_t frames_ = 0;
+    uint32_t seq_ = 0;
+    std::vector<uint32_t> prev_;
+    std::unique_ptr<Frame> pending_;
+};
+
+// ---------- Animated WebP ----------
+#ifdef HAVE_LIBWEBP
+// libwebp's animation encoder does its own sub-frame rectangles and frame merging
+class WebpAnimWriter : public AnimWriter {
+public:
+    ~WebpAnimWriter() override {
+        if (enc_) WebPAnimEncoderDelete(enc_);
+    }
+
+    bool open(const std::string& path, int width, int height) override {
+        path_ = path; w_ = width; h_ = height;
+        WebPAnimEncoderOptions opts;
+        if (!WebPAnimEncoderOptionsInit(&opts)) return false;
+        opts.anim_params.loop_count = 1;
+        opts.minimize_size = 1;
+        enc_ = WebPAnimEncoderNew(w_, h_, &opts);
+        if (!enc_ || !WebPConfigInit(&config_)) return false;
+        config_.lossless = 1;
+        return true;
+    }
+
+    bool addFrame(const uint32_t* pixels, int stride_bytes, int delay_ms) override {
+        if (!enc_) return false;
+        WebPPicture pic;
+        if (!WebPPictureInit(&pic)) return false;
+        pic.use_argb = 1;
+        pic.width = w_; pic.height = h_;
+        if (!WebPPictureAlloc(&pic)) return false;
+
+        // WebP wants straight 0xAARRGGBB words, which is cairo's layout minus premultiplication
+        for (int y = 0; y < h_; ++y) {
+            uint32_t* dst = pic.argb + (size_t)y * pic.argb_stride;
+            std::memcpy(dst, pixels + (size_t)y * (stride_bytes / 4), (size_t)w_ * 4);
+            unpremultiply_argb32_inplace(dst, (size_t)w_);
+        }
+        const bool ok = WebPAnimEncoderAdd(enc_, &pic, timestamp_ms_, &config_);
+        WebPPictureFree(&pic);
+        timestamp_ms_ += delay_ms;
+        return ok;
+    }
+
+    bool close() override {
+        if (!enc_) return false;
+        WebPData data;
+        WebPDataInit(&data);
+        bool ok = WebPAnimEncoderAdd(enc_, nullptr, timestamp_ms_, nullptr) &&
+                  WebPAnimEncoderAssemble(enc_, &data);
+        if (ok) {
+            std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(data.bytes), data.size);
+            ok = (bool)out;
+        } else {
+            std::cerr << "WebP: " << WebPAnimEncoderGetError(enc_) << "\n";
+        }
+        WebPDataClear(&data);
+        WebPAnimEncoderDelete(enc_);
+        enc_ = nullptr;
+        return ok;
+    }
+
+private:
+    std::string path_;
+    int w_ = 0, h_ = 0;
+    int timestamp_ms_ = 0;
+    WebPAnimEncoder* enc_ = nullptr;
+    WebPConfig config_;
+};
+#endif
+
+std::unique_ptr<AnimWriter> makeAnimWriter(const std::string& format) {
+    if (format == "apng") return std::unique_ptr<AnimWriter>(new ApngWriter());
+#ifdef HAVE_LIBWEBP
+    if (format == "webp") return std::unique_ptr<AnimWriter>(new WebpAnimWriter());
+#else
+    if (format == "webp") {
+        std::cerr << "Animated WebP needs a build with HAVE_LIBWEBP\n";
+        return nullptr;
+    }
+#endif
+    std::cerr << "Unknown animation format: " << format << "\n";
+    return nullptr;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cairo.h>
+
+// Animated image sink for fixed-size frames. Frames are premultiplied ARGB32
+// (cairo layout); only the rectangle that changed since the previous frame is
+// encoded, and unchanged frames just extend the previous frame's delay.
+class AnimWriter {
+public:
+    virtual ~AnimWriter() = default;
+
+    virtual bool open(const std::string& path, int width, int height) = 0;
+    virtual bool addFrame(const uint32_t* pixels, int stride_bytes, int delay_ms) = 0;
+    virtual bool close() = 0;
+
+    // Flush the surface and forward its pixels
+    bool addFrame(cairo_surface_t* frame, int delay_ms);
+};
+
+// "apng" or "webp" (webp only when built with HAVE_LIBWEBP). nullptr if unavailable.
+std::unique_ptr<AnimWriter> makeAnimWriter(const std::string& format);
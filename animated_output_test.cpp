@@ -0,0 +1,212 @@
+// APNG writer output decoded by hand: chunk CRCs, acTL patched with the real frame
+// count, fcTL/fdAT sequence numbers running 0, 1, 2, ... with no gaps, each delta
+// frame's rectangle covering exactly what changed, unchanged frames folded into
+// the previous delay, and every frame's pixels inflating back to the input.
+// Build: g++ -O2 -std=c++17 animated_output_test.cpp animated_output.cpp color_math.cpp
+//        $(pkg-config --cflags --libs cairo zlib) -o animated_output_test
+#include "animated_output.hpp"
+#include "color_math.hpp"
+#include <zlib.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static int g_failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    if (ok) return;
+    ++g_failures;
+    if (g_failures <= 20) std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+}
+
+static uint32_t be32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+static uint16_t be16(const uint8_t* p) { return (uint16_t)(p[0] << 8 | p[1]); }
+
+struct Chunk {
+    std::string type;
+    std::vector<uint8_t> data;
+    bool crc_ok;
+};
+
+static bool read_chunks(const std::string& path, std::vector<Chunk>& chunks) {
+    std::ifstream in(path, std::ios::binary);
+    const std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    static const uint8_t sig[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (file.size() < 8 || !std::equal(sig, sig + 8, file.begin())) return false;
+    size_t at = 8;
+    while (at + 12 <= file.size()) {
+        const uint32_t len = be32(&file[at]);
+        if (at + 12 + len > file.size()) return false;
+        Chunk c;
+        c.type.assign(reinterpret_cast<const char*>(&file[at + 4]), 4);
+        c.data.assign(file.begin() + at + 8, file.begin() + at + 8 + len);
+        const uLong crc = crc32(0L, &file[at + 4], 4 + len);
+        c.crc_ok = crc == be32(&file[at + 8 + len]);
+        chunks.push_back(std::move(c));
+        at += 12 + len;
+    }
+    return at == file.size();
+}
+
+// Inflate and unfilter a w x h RGBA region
+static bool decode_region(const std::vector<uint8_t>& z, int w, int h, std::vector<uint8_t>& rgba) {
+    const size_t row = (size_t)w * 4;
+    std::vector<uint8_t> raw((row + 1) * h);
+    uLongf len = (uLongf)raw.size();
+    if (uncompress(raw.data(), &len, z.data(), (uLong)z.size()) != Z_OK || len != raw.size()) return false;
+    rgba.assign(row * h, 0);
+    for (int y = 0; y < h; ++y) {
+        const uint8_t type = raw[(row + 1) * y];
+        const uint8_t* src = &raw[(row + 1) * y + 1];
+        uint8_t* cur = &rgba[row * y];
+        const uint8_t* up = y ? &rgba[row * (y - 1)] : nullptr;
+        for (size_t i = 0; i < row; ++i) {
+            const int a = i >= 4 ? cur[i - 4] : 0, b = up ? up[i] : 0, c = (up && i >= 4) ? up[i - 4] : 0;
+            int pred = 0;
+            switch (type) {
+                case 0: break;
+                case 1: pred = a; break;
+                case 2: pred = b; break;
+                case 3: pred = (a + b) / 2; break;
+                case 4: {
+                    const int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                    pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                    break;
+                }
+                default: return false;
+            }
+            cur[i] = (uint8_t)(src[i] + pred);
+        }
+    }
+    return true;
+}
+
+// Frame as the decoder should see it: straight RGBA of the given rectangle
+static std::vector<uint8_t> expected_rgba(const std::vector<uint32_t>& px, int stride, int x, int y, int w, int h) {
+    std::vector<uint8_t> out;
+    for (int j = 0; j < h; ++j) {
+        std::vector<uint32_t> row(&px[(size_t)(y + j) * stride + x], &px[(size_t)(y + j) * stride + x + w]);
+        unpremultiply_argb32_inplace(row.data(), row.size());
+        for (uint32_t p : row) {
+            out.push_back((p >> 16) & 0xFF);
+            out.push_back((p >> 8) & 0xFF);
+            out.push_back(p & 0xFF);
+            out.push_back(p >> 24);
+        }
+    }
+    return out;
+}
+
+int main() {
+    const fs::path dir = fs::temp_directory_path() / "animated_output_test";
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    const std::string path = (dir / "countdown.png").string();
+
+    // 7x5 with padded rows (stride 9 pixels), premultiplied, some translucent pixels
+    const int W = 7, H = 5, S = 9;
+    std::vector<uint32_t> f0((size_t)S * H, 0xdeadbeef);
+    for (int y = 0; y < H; ++y)
+        for (int x = 0; x < W; ++x) {
+            const uint32_t a = (x + y) % 3 == 0 ? 0x80 : 0xFF;
+            const uint32_t c = (uint32_t)(x * 30 + y * 10) * a / 255;
+            f0[(size_t)y * S + x] = a << 24 | c << 16 | (a - c) << 8 | (a / 2);
+        }
+    std::vector<uint32_t> f1 = f0;   // change inside x 2..4, y 1..2
+    f1[1 * S + 2] = 0xff112233;
+    f1[2 * S + 4] = 0x40102030;
+    std::vector<uint32_t> f2 = f1;   // one pixel in the far corner
+    f2[4 * S + 6] = 0x00000000;
+
+    struct Want { int x, y, w, h, delay; const std::vector<uint32_t>* px; };
+    const Want want[] = {
+        { 0, 0, W, H, 100, &f0 },
+        { 2, 1, 3, 2, 250 + 300, &f1 },   // the unchanged frame after it extends its delay
+        { 6, 4, 1, 1, 40, &f2 },
+    };
+
+    std::unique_ptr<AnimWriter> writer = makeAnimWriter("apng");
+    check(writer && writer->open(path, W, H), "open");
+    if (writer) {
+        check(writer->addFrame(f0.data(), S * 4, 100), "frame 0");
+        check(writer->addFrame(f1.data(), S * 4, 250), "frame 1");
+        check(writer->addFrame(f1.data(), S * 4, 300), "frame 1 again");
+        check(writer->addFrame(f2.data(), S * 4, 40), "frame 2");
+        check(writer->close(), "close");
+    }
+
+    std::vector<Chunk> chunks;
+    check(read_chunks(path, chunks), "signature and chunk framing");
+    std::string order;
+    for (const Chunk& c : chunks) {
+        order += (order.empty() ? "" : " ") + c.type;
+        check(c.crc_ok, c.type + ": CRC");
+    }
+    check(order == "IHDR acTL fcTL IDAT fcTL fdAT fcTL fdAT IEND", "chunk order: " + order);
+
+    uint32_t next_seq = 0;
+    size_t frame = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const Chunk& c = chunks[i];
+        const std::vector<uint8_t>& d = c.data;
+        if (c.type == "IHDR") {
+            check(d.size() == 13 && be32(&d[0]) == (uint32_t)W && be32(&d[4]) == (uint32_t)H && d[8] == 8 && d[9] == 6,
+                  "IHDR: 7x5 RGBA8");
+        } else if (c.type == "acTL") {
+            check(d.size() == 8 && be32(&d[0]) == 3 && be32(&d[4]) == 1, "acTL: 3 frames, played once");
+        } else if (c.type == "fcTL" && frame < 3 && d.size() == 26) {
+            const Want& f = want[frame];
+            const std::string what = "frame " + std::to_string(frame);
+            check(be32(&d[0]) == next_seq++, what + ": fcTL sequence number");
+            check((int)be32(&d[4]) == f.w && (int)be32(&d[8]) == f.h && (int)be32(&d[12]) == f.x &&
+                  (int)be32(&d[16]) == f.y,
+                  what + ": rect " + std::to_string(be32(&d[12])) + "," + std::to_string(be32(&d[16])) + " " +
+                  std::to_string(be32(&d[4])) + "x" + std::to_string(be32(&d[8])));
+            check(be16(&d[20]) == f.delay && be16(&d[22]) == 1000, what + ": delay");
+            check(d[24] == 0 && d[25] == 0, what + ": dispose NONE, blend SOURCE");
+
+            // Image data follows: IDAT for the first frame, fdAT (with its own sequence number) after
+            if (i + 1 < chunks.size()) {
+                const Chunk& img = chunks[i + 1];
+                std::vector<uint8_t> z = img.data;
+                if (img.type == "fdAT" && z.size() >= 4) {
+                    check(be32(&z[0]) == next_seq++, what + ": fdAT sequence number");
+                    z.erase(z.begin(), z.begin() + 4);
+                }
+                std::vector<uint8_t> rgba;
+                check(decode_region(z, f.w, f.h, rgba), what + ": inflate");
+                check(rgba == expected_rgba(*f.px, S, f.x, f.y, f.w, f.h), what + ": pixels");
+            }
+            ++frame;
+        }
+    }
+    check(frame == 3 && next_seq == 5, "three frames, sequence numbers 0..4");
+
+    // No frames: close fails and leaves no file
+    const std::string empty = (dir / "empty.png").string();
+    std::unique_ptr<AnimWriter> none = makeAnimWriter("apng");
+    check(none && none->open(empty, W, H) && !none->close() && !fs::exists(empty), "empty animation removed");
+
+#ifdef HAVE_LIBWEBP
+    check(makeAnimWriter("webp") != nullptr, "webp writer with HAVE_LIBWEBP");
+#else
+    check(makeAnimWriter("webp") == nullptr, "no webp writer without HAVE_LIBWEBP");
+#endif
+
+    fs::remove_all(dir, ec);
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("animated_output: APNG chunks, sequence numbers, delta rects and pixels as expected\n");
+    return 0;
+}
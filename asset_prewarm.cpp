@@ -0,0 +1,208 @@
+#include "asset_prewarm.hpp"
+#include "layer_cache.hpp"
+#include "rsvg_render.hpp"
+#include <cairo.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+static const char kAtlasMagic[4] = { 'A', 'T', 'L', '2' };
+
+struct PrewarmKey {
+    LayerKey key;
+    const PrewarmSet* set;
+};
+
+// All (asset, size) pairs described by the sets, sorted for a stable atlas order
+static std::vector<PrewarmKey> collect_keys(const std::vector<PrewarmSet>& sets) {
+    std::vector<PrewarmKey> keys;
+    for (const auto& set : sets) {
+        std::error_code ec;
+        std::vector<std::string> svgs;
+        for (const auto& entry : fs::directory_iterator(set.dir, ec)) {
+            const std::string name = entry.path().filename().string();
+            if (entry.is_regular_file() && name.size() >= set.suffix.size() &&
+                name.compare(name.size() - set.suffix.size(), set.suffix.size(), set.suffix) == 0)
+                svgs.push_back(entry.path().generic_string());
+        }
+        std::sort(svgs.begin(), svgs.end());
+        for (const auto& svg : svgs)
+            for (const auto& wh : set.sizes)
+                keys.push_back({ { svg, set.color_key, wh.first, wh.second }, &set });
+    }
+    return keys;
+}
+
+size_t prewarm_assets(const std::vector<PrewarmSet>& sets, unsigned threads, size_t* rendered) {
+    const std::vector<PrewarmKey> keys = collect_keys(sets);
+    if (rendered) *rendered = 0;
+    if (keys.empty()) return 0;
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, (unsigned)keys.size());
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> warmed{0}, misses{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < keys.size(); i = next++) {
+            const LayerKey& k = keys[i].key;
+            if (cairo_surface_t* hit = layer_cache_find(k)) {
+                ++warmed;
+                cairo_surface_destroy(hit);
+                continue;
+            }
+            // Kept with the cache entry for refreshes, so capture by value
+            LayerRenderFn render;
+            if (keys[i].set->render)
+                render = [asset = k.asset, fn = keys[i].set->render](int w, int h) { return fn(asset, w, h); };
+            else
+                render = [asset = k.asset](int w, int h) { return renderSvgToSurface(asset, w, h, 1); };
+            cairo_surface_t* s = layer_cache_get(k, render);
+            if (s) { ++warmed; ++misses; cairo_surface_destroy(s); }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) pool.emplace_back(worker);
+    for (auto& th : pool) th.join();
+    if (rendered) *rendered = misses;
+    return warmed;
+}
+
+size_t prewarm_with_atlas(const std::string& atlas_path, const std::vector<PrewarmSet>& sets,
+                          unsigned threads) {
+    size_t stale = 0, rendered = 0;
+    if (!atlas_path.empty()) prewarm_load_atlas(atlas_path, &stale);
+    const size_t warmed = prewarm_assets(sets, threads, &rendered);
+    if (!atlas_path.empty() && (stale > 0 || rendered > 0)) prewarm_save_atlas(atlas_path, sets);
+    return warmed;
+}
+
+// ---- Atlas file ----
+// "ATL2", u32 count, then per entry:
+//   u32 path_len, path, u32 color_len, color key, i64 mtime, u32 w, u32 h,
+//   w*h*4 bytes of premultiplied ARGB32
+static void write_u32(std::ofstream& out, uint32_t v) { out.write(reinterpret_cast<const char*>(&v), 4); }
+static bool read_u32(std::ifstream& in, uint32_t& v) { return (bool)in.read(reinterpret_cast<char*>(&v), 4); }
+
+struct AtlasEntry {
+    LayerKey key;
+    cairo_surface_t* surface;
+    int64_t mtime;   // of the asset the pixels were rendered from
+};
+
+bool prewarm_save_atlas(const std::string& atlas_path, const std::vector<PrewarmSet>& sets) {
+    std::vector<AtlasEntry> entries;
+    size_t evicted = 0;
+    for (const auto& k : collect_keys(sets)) {
+        int64_t mtime = kLayerMtimeUnknown;
+        cairo_surface_t* s = layer_cache_find(k.key, &mtime);
+        if (!s) {
+            ++evicted;
+            continue;
+        }
+        // Stamped with the file it came from, not the file as it is now, so a layer
+        // rendered before an edit is seen as stale on the next load
+        if (mtime == kLayerMtimeUnknown) {
+            cairo_surface_destroy(s);
+            continue;
+        }
+        entries.push_back({ k.key, s, mtime });
+    }
+    if (evicted)
+        std::cerr << "Atlas " << atlas_path << ": " << evicted << " layer(s) no longer in the layer cache were "
+                  << "left out (raise LAYER_CACHE_MAX_MB to keep them)\n";
+
+    const std::string tmp = atlas_path + ".tmp";
+    bool ok = false;
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (out) {
+            out.write(kAtlasMagic, 4);
+            write_u32(out, (uint32_t)entries.size());
+            for (auto& e : entries) {
+                const LayerKey& k = e.key;
+                cairo_surface_t* s = e.surface;
+                cairo_surface_flush(s);
+                const int stride = cairo_image_surface_get_stride(s);
+                const unsigned char* data = cairo_image_surface_get_data(s);
+
+                write_u32(out, (uint32_t)k.asset.size());
+                out.write(k.asset.data(), k.asset.size());
+                write_u32(out, (uint32_t)k.color_key.size());
+                out.write(k.color_key.data(), k.color_key.size());
+                out.write(reinterpret_cast<const char*>(&e.mtime), sizeof(e.mtime));
+                write_u32(out, (uint32_t)k.width);
+                write_u32(out, (uint32_t)k.height);
+                for (int y = 0; y < k.height; ++y)
+                    out.write(reinterpret_cast<const char*>(data + (size_t)y * stride), (size_t)k.width * 4);
+            }
+            ok = (bool)out;
+        }
+    }
+    for (auto& e : entries) cairo_surface_destroy(e.surface);
+
+    if (ok) ok = std::rename(tmp.c_str(), atlas_path.c_str()) == 0;
+    if (!ok) {
+        std::remove(tmp.c_str());
+        std::cerr << "Failed to write atlas " << atlas_path << "\n";
+    }
+    return ok;
+}
+
+size_t prewarm_load_atlas(const std::string& atlas_path, size_t* stale) {
+    if (stale) *stale = 0;
+    std::ifstream in(atlas_path, std::ios::binary);
+    if (!in) return 0;
+
+    char magic[4];
+    uint32_t count = 0;
+    if (!in.read(magic, 4) || std::memcmp(magic, kAtlasMagic, 4) != 0 || !read_u32(in, count)) {
+        std::cerr << "Not an atlas file: " << atlas_path << "\n";
+        return 0;
+    }
+
+    size_t loaded = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t path_len = 0, color_len = 0, w = 0, h = 0;
+        int64_t mtime = 0;
+        if (!read_u32(in, path_len) || path_len > 4096) break;
+        std::string path(path_len, '\0');
+        if (!in.read(&path[0], path_len)) break;
+        if (!read_u32(in, color_len) || color_len > 4096) break;
+        std::string color(color_len, '\0');
+        if (!in.read(&color[0], color_len)) break;
+        if (!in.read(reinterpret_cast<char*>(&mtime), sizeof(mtime))) break;
+        if (!read_u32(in, w) || !read_u32(in, h) || w == 0 || h == 0 || w > 32768 || h > 32768) break;
+
+        const size_t row_bytes = (size_t)w * 4;
+        if (layer_asset_mtime(path) != mtime) {
+            // Asset edited or removed since the atlas was built; re-rendered by the caller
+            in.seekg((std::streamoff)(row_bytes * h), std::ios::cur);
+            if (stale) ++*stale;
+            continue;
+        }
+
+        cairo_surface_t* s = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, (int)w, (int)h);
+        unsigned char* data = cairo_image_surface_get_data(s);
+        const int stride = cairo_image_surface_get_stride(s);
+        bool rows_ok = true;
+        for (uint32_t y = 0; y < h && rows_ok; ++y)
+            rows_ok = (bool)in.read(reinterpret_cast<char*>(data + (size_t)y * stride), row_bytes);
+        if (!rows_ok) { cairo_surface_destroy(s); break; }
+
+        cairo_surface_mark_dirty(s);
+        layer_cache_put({ path, color, (int)w, (int)h }, s, mtime);
+        cairo_surface_destroy(s);
+        ++loaded;
+    }
+    return loaded;
+}
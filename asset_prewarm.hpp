@@ -0,0 +1,35 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include <cairo.h>
+
+// Every file in `dir` ending in `suffix` is rasterized at each of `sizes` (width, height)
+// into the layer key { path, color_key, width, height }. `render` defaults to
+// renderSvgToSurface(); set it (and color_key) to warm the keys of another loader.
+struct PrewarmSet {
+    std::string dir;
+    std::vector<std::pair<int, int>> sizes;
+    std::string suffix = ".svg";
+    std::string color_key;
+    std::function<cairo_surface_t*(const std::string& path, int width, int height)> render;
+};
+
+// Rasterize all assets of the sets into the layer cache on a thread pool
+// (threads == 0 uses all cores). Returns the number of layers now cached; `rendered`
+// (optional) receives how many of them were not in the cache beforehand.
+size_t prewarm_assets(const std::vector<PrewarmSet>& sets, unsigned threads = 0, size_t* rendered = nullptr);
+
+// Write every cached layer of the sets to a single atlas file.
+bool prewarm_save_atlas(const std::string& atlas_path, const std::vector<PrewarmSet>& sets);
+
+// Load an atlas into the layer cache. Entries whose asset changed (or is gone) since
+// the atlas was written are skipped and counted in `stale`. Returns the number of
+// layers loaded (0 if missing/invalid).
+size_t prewarm_load_atlas(const std::string& atlas_path, size_t* stale = nullptr);
+
+// Load the atlas (if any), rasterize whatever it did not supply (new or edited
+// assets) and rewrite it when it was missing, stale or incomplete. An empty path
+// is a plain prewarm_assets(). Returns the number of layers now cached.
+size_t prewarm_with_atlas(const std::string& atlas_path, const std::vector<PrewarmSet>& sets,
+                          unsigned threads = 0);
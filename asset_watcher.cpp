@@ -0,0 +1,118 @@
+#include "asset_watcher.hpp"
+#include "layer_cache.hpp"
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// Quiet period after the last event before a batch is processed: editors often
+// write, truncate and rename in quick succession
+static const int kSettleMs = 15;
+// ...but never hold a batch longer than this while events keep arriving
+static const int kMaxBatchMs = 100;
+
+static const uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+
+bool AssetWatcher::start(const std::vector<std::string>& dirs, ChangeFn on_change) {
+    if (fd_ >= 0) return false;
+
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) {
+        std::cerr << "inotify_init1 failed: " << std::strerror(errno) << "\n";
+        return false;
+    }
+    for (const std::string& dir : dirs) {
+        int wd = inotify_add_watch(fd_, dir.c_str(), kWatchMask);
+        if (wd < 0) {
+            std::cerr << "Cannot watch " << dir << ": " << std::strerror(errno) << "\n";
+            continue;
+        }
+        std::string d = dir;
+        while (d.size() > 1 && d.back() == '/') d.pop_back();
+        dirs_[wd] = d;
+    }
+    if (dirs_.empty() || pipe2(wake_, O_CLOEXEC) != 0) {
+        ::close(fd_);
+        fd_ = -1;
+        dirs_.clear();
+        return false;
+    }
+
+    on_change_ = std::move(on_change);
+    thread_ = std::thread([this] { run(); });
+    return true;
+}
+
+void AssetWatcher::stop() {
+    if (fd_ < 0) return;
+    char c = 0;
+    if (::write(wake_[1], &c, 1) < 0) { /* thread is exiting anyway */ }
+    if (thread_.joinable()) thread_.join();
+    ::close(fd_);
+    ::close(wake_[0]);
+    ::close(wake_[1]);
+    fd_ = -1;
+    wake_[0] = wake_[1] = -1;
+    dirs_.clear();
+}
+
+void AssetWatcher::flush(std::set<std::string>& changed) {
+    for (const std::string& path : changed) {
+        size_t n = layer_cache_refresh_asset(path);
+        ++reloads_;
+        if (on_change_) on_change_(path, n);
+    }
+    changed.clear();
+}
+
+void AssetWatcher::run() {
+    alignas(struct inotify_event) char buf[16 * 1024];
+    std::set<std::string> changed;
+    std::chrono::steady_clock::time_point batch_start;
+
+    for (;;) {
+        pollfd fds[2] = { { fd_, POLLIN, 0 }, { wake_[0], POLLIN, 0 } };
+        // Block until something happens; once a batch is pending, wait only for it to settle
+        int r = ::poll(fds, 2, changed.empty() ? -1 : kSettleMs);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Asset watcher poll failed: " << std::strerror(errno) << "\n";
+            return;
+        }
+        if (fds[1].revents) return;
+        if (r == 0) {
+            flush(changed);
+            continue;
+        }
+
+        ssize_t len;
+        while ((len = ::read(fd_, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + len;) {
+                auto* ev = reinterpret_cast<struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + ev->len;
+                if (ev->mask & IN_Q_OVERFLOW) {
+                    // Lost events: nothing better than dropping everything we hold
+                    std::cerr << "Asset watcher queue overflow; clearing layer cache\n";
+                    layer_cache_clear();
+                    continue;
+                }
+                if (!ev->len || (ev->mask & IN_ISDIR)) continue;
+                auto dir = dirs_.find(ev->wd);
+                if (dir == dirs_.end()) continue;
+
+                std::string name = ev->name;
+                // Editor swap/backup files never back a layer
+                if (name.empty() || name[0] == '.' || name.back() == '~') continue;
+                if (changed.empty()) batch_start = std::chrono::steady_clock::now();
+                changed.insert(dir->second + "/" + name);
+            }
+        }
+        if (!changed.empty() &&
+            std::chrono::steady_clock::now() - batch_start >= std::chrono::milliseconds(kMaxBatchMs))
+            flush(changed);
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches asset directories with inotify and, on a background thread, refreshes
+// just the layer-cache entries of files that were written, replaced or deleted
+// (layer_cache_refresh_asset). Bursts from a single save are coalesced for a few ms.
+// Directories are watched non-recursively (chars/, border/ are flat).
+class AssetWatcher {
+public:
+    // Called on the watcher thread after an asset's layers were refreshed
+    using ChangeFn = std::function<void(const std::string& path, size_t refreshed)>;
+
+    AssetWatcher() = default;
+    ~AssetWatcher() { stop(); }
+    AssetWatcher(const AssetWatcher&) = delete;
+    AssetWatcher& operator=(const AssetWatcher&) = delete;
+
+    // Paths passed to the cache are "<dir>/<file>" with dir exactly as given here,
+    // so use the same spelling the layer keys use (e.g. "chars", not "./chars/").
+    bool start(const std::vector<std::string>& dirs, ChangeFn on_change = nullptr);
+    void stop();
+
+    size_t reloads() const { return reloads_; }
+
+private:
+    void run();
+    void flush(std::set<std::string>& changed);
+
+    int fd_ = -1;
+    int wake_[2] = { -1, -1 };
+    std::map<int, std::string> dirs_;   // watch descriptor -> directory
+    ChangeFn on_change_;
+    std::thread thread_;
+    std::atomic<size_t> reloads_{0};
+};
@@ -3,30 +3,24 @@
 #include <functional>
 #include <cmath>
 #include <iostream>
-
-// HSV → RGB helper
-static void hsv_to_rgb(double h, double s, double v, double& r, double& g, double& b) {
-    double c = v * s;
-    double x = c * (1 - std::fabs(std::fmod(h / 60.0, 2) - 1));
-    double m = v - c;
-    double r1=0,g1=0,b1=0;
-    if      (h < 60)  { r1=c; g1=x; b1=0; }
-    else if (h < 120) { r1=x; g1=c; b1=0; }
-    else if (h < 180) { r1=0; g1=c; b1=x; }
-    else if (h < 240) { r1=0; g1=x; b1=c; }
-    else if (h < 300) { r1=x; g1=0; b1=c; }
-    else              { r1=c; g1=0; b1=x; }
-    r = r1 + m; g = g1 + m; b = b1 + m;
-}
+#include <fstream>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+#include <cstdlib>
+#include "cairo_set_source_rgba.hpp"
+#include "layer_cache.hpp"
+#include "color_math.hpp"
+#include "trace.hpp"
 
 // Turn any string (e.g., a name, hex, or arbitrary key) into RGBA
 static void string_to_rgba(const std::string& key, double& r, double& g, double& b, double& a) {
     // If user passes a #RRGGBB or #RRGGBBAA, honor it directly
     if (!key.empty() && key[0] == '#') {
-        unsigned int rv=255, gv=255, bv=255, av=255;
-        if (key.size() == 7)       { sscanf(key.c_str()+1, "%02x%02x%02x", &rv, &gv, &bv); }
-        else if (key.size() == 9)  { sscanf(key.c_str()+1, "%02x%02x%02x%02x", &rv, &gv, &bv, &av); }
-        r = rv/255.0; g = gv/255.0; b = bv/255.0; a = (key.size()==9 ? av/255.0 : 1.0);
+        if (!parse_hex_rgba(key, r, g, b, a)) { r = g = b = a = 1.0; }
         return;
     }
 
@@ -39,14 +33,8 @@ static void string_to_rgba(const std::string& key, double& r, double& g, double&
     a = 1.0;
 }
 
-// Example draw: colored rounded rect background + text stub
-void draw_colored_frame(const std::string& color_key, int W, int H, const char* out_png) {
-    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, W, H);
-    cairo_t* cr = cairo_create(surface);
-
-    // Background
-    double r,g,b,a;
-    string_to_rgba(color_key, r, g, b, a);
+// Rounded rect path filled with a solid colour
+static void fill_rounded_rect(cairo_t* cr, double r, double g, double b, double a, int W, int H) {
     cairo_set_source_rgba(cr, r, g, b, a);
     double radius = 24.0;
     // rounded rect path
@@ -57,19 +45,160 @@ void draw_colored_frame(const std::string& color_key, int W, int H, const char*
     cairo_arc(cr, radius, radius, radius, M_PI, 3*M_PI/2);
     cairo_close_path(cr);
     cairo_fill(cr);
+}
 
-    // Foreground white bar
+// Foreground white bar
+static void draw_foreground_bar(cairo_t* cr, int W, int H) {
     cairo_set_source_rgba(cr, 1, 1, 1, 0.92);
     cairo_rectangle(cr, 20, H/2 - 20, W - 40, 40);
     cairo_fill(cr);
+}
+
+// Rounded rect background in the key's colour; static per (key, size) so it is cached
+static cairo_surface_t* render_rounded_background(const std::string& color_key, int W, int H) {
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, W, H);
+    cairo_t* cr = cairo_create(surface);
+
+    double r,g,b,a;
+    string_to_rgba(color_key, r, g, b, a);
+    fill_rounded_rect(cr, r, g, b, a, W, H);
+
+    cairo_destroy(cr);
+    return surface;
+}
+
+// Example draw: colored rounded rect background + text stub
+void draw_colored_frame(const std::string& color_key, int W, int H, const char* out_png) {
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, W, H);
+    cairo_t* cr = cairo_create(surface);
+
+    // Background (blit the cached layer)
+    cairo_surface_t* background = layer_cache_get(
+        { "rounded-rect", color_key, W, H },
+        [color_key](int w, int h) { return render_rounded_background(color_key, w, h); });
+    if (background) {
+        cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(cr, background, 0, 0);
+        cairo_paint(cr);
+        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+        cairo_surface_destroy(background);
+    }
 
-    cairo_surface_write_to_png(surface, out_png);
+    draw_foreground_bar(cr, W, H);
+
+    {
+        TRACE_SCOPE("png.encode");
+        TRACE_BYTES((uint64_t)cairo_image_surface_get_stride(surface) * H);
+        cairo_surface_write_to_png(surface, out_png);
+    }
     cairo_destroy(cr);
     cairo_surface_destroy(surface);
 }
 
+// ---- Batch mode ----
+// Batch mode and main() are left out when built into render_daemon with
+// -DRENDER_TOOL_NO_MAIN
+#ifndef RENDER_TOOL_NO_MAIN
+struct Rgba { double r, g, b, a; };
+
+// Keep file names portable: anything outside [A-Za-z0-9_-] becomes '_'
+static std::string sanitize_file_name(const std::string& key) {
+    std::string out = key;
+    for (char& c : out) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+        if (!ok) c = '_';
+    }
+    return out.empty() ? std::string("_") : out;
+}
+
+// Render one frame per distinct key. Colours are resolved once per key, and each
+// worker owns a single surface/context that is cleared and redrawn for every frame,
+// so the per-frame cost is the fill plus the PNG encode, spread over all cores.
+static int draw_colored_frames_batch(std::istream& keys_in, const std::string& out_dir,
+                                     int W, int H, unsigned threads) {
+    std::vector<std::string> keys;
+    std::unordered_map<std::string, Rgba> palette;
+    std::string line;
+    while (std::getline(keys_in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || palette.count(line)) continue;
+        Rgba c;
+        string_to_rgba(line, c.r, c.g, c.b, c.a);
+        palette.emplace(line, c);
+        keys.push_back(line);
+    }
+    if (keys.empty()) { std::cerr << "No color keys given\n"; return 1; }
+
+    // Distinct keys can still sanitize to the same name; suffix the later ones
+    std::vector<std::string> out_paths;
+    out_paths.reserve(keys.size());
+    std::unordered_map<std::string, int> name_uses;
+    for (const auto& k : keys) {
+        std::string name = sanitize_file_name(k);
+        int n = name_uses[name]++;
+        if (n > 0) name += "-" + std::to_string(n);
+        out_paths.push_back(out_dir + "/" + name + ".png");
+    }
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, (unsigned)keys.size());
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> failed{0};
+    auto worker = [&]() {
+        cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, W, H);
+        cairo_t* cr = cairo_create(surface);
+        for (size_t i = next++; i < keys.size(); i = next++) {
+            const Rgba& c = palette.at(keys[i]);
+
+            cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+            cairo_paint(cr);
+            cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+            fill_rounded_rect(cr, c.r, c.g, c.b, c.a, W, H);
+            draw_foreground_bar(cr, W, H);
+
+            cairo_surface_flush(surface);
+            TRACE_SCOPE("png.encode");
+            TRACE_BYTES((uint64_t)cairo_image_surface_get_stride(surface) * H);
+            if (cairo_surface_write_to_png(surface, out_paths[i].c_str()) != CAIRO_STATUS_SUCCESS) {
+                std::cerr << "Failed to write " << out_paths[i] << "\n";
+                ++failed;
+            }
+        }
+        cairo_destroy(cr);
+        cairo_surface_destroy(surface);
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) pool.emplace_back(worker);
+    for (auto& th : pool) th.join();
+
+    std::cout << "Wrote " << (keys.size() - failed) << " frames to " << out_dir
+              << " using " << threads << " threads\n";
+    return failed ? 1 : 0;
+}
+
 int main(int argc, char** argv) {
     // Usage: app <color_key> <out.png>
+    //        app --batch <keys.txt|-> <out_dir> [threads]   (one color key per line)
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " --batch <keys.txt|-> <out_dir> [threads]\n";
+            return 1;
+        }
+        const std::string keys_path = argv[2];
+        const std::string out_dir   = argv[3];
+        unsigned threads = (argc > 4) ? (unsigned)std::max(0, std::atoi(argv[4])) : 0;
+
+        std::error_code ec;
+        std::filesystem::create_directories(out_dir, ec);
+
+        if (keys_path == "-") return draw_colored_frames_batch(std::cin, out_dir, 800, 300, threads);
+        std::ifstream keys_in(keys_path);
+        if (!keys_in) { std::cerr << "Cannot open " << keys_path << "\n"; return 1; }
+        return draw_colored_frames_batch(keys_in, out_dir, 800, 300, threads);
+    }
+
     std::string colorKey = (argc > 1) ? argv[1] : "Nerofea";
     const char* outPng   = (argc > 2) ? argv[2] : "frame.png";
 
@@ -77,3 +206,4 @@ int main(int argc, char** argv) {
     std::cout << "Wrote " << outPng << " using color key: " << colorKey << "\n";
     return 0;
 }
+#endif
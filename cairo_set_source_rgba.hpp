@@ -0,0 +1,5 @@
+#pragma once
+#include <string>
+
+// Colored rounded-rect frame for a color key (name, hex, or any string) written to out_png
+void draw_colored_frame(const std::string& color_key, int W, int H, const char* out_png);
@@ -0,0 +1,253 @@
+#include "color_math.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ---- Scalar helpers ----
+void rgb_to_hsv(double R, double G, double B, double& h, double& s, double& v){
+    double mx = std::fmax(R, std::fmax(G, B));
+    double mn = std::fmin(R, std::fmin(G, B));
+    v = mx; double d = mx - mn; s = (mx == 0 ? 0 : d / mx);
+    if (d == 0) { h = 0; return; }
+    if (mx == R) h = 60.0 * std::fmod(((G - B) / d), 6.0);
+    else if (mx == G) h = 60.0 * (((B - R) / d) + 2.0);
+    else h = 60.0 * (((R - G) / d) + 4.0);
+    if (h < 0) h += 360.0;
+}
+
+void hsv_to_rgb(double h, double s, double v, double& R, double& G, double& B){
+    double C = v * s;
+    double X = C * (1 - std::fabs(std::fmod(h/60.0, 2) - 1));
+    double m = v - C;
+    double r=0,g=0,b=0;
+    if (h < 60)      { r=C; g=X; b=0; }
+    else if (h<120 ) { r=X; g=C; b=0; }
+    else if (h<180 ) { r=0; g=C; b=X; }
+    else if (h<240 ) { r=0; g=X; b=C; }
+    else if (h<300 ) { r=X; g=0; b=C; }
+    else             { r=C; g=0; b=X; }
+    R=r+m; G=g+m; B=b+m;
+}
+
+// ---- Hex parsing (no sscanf) ----
+static inline int hex_nibble(char c){
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool parse_hex_rgba8(const std::string& hex, uint8_t rgba[4]){
+    if (hex.empty() || hex[0] != '#') return false;
+    if (hex.size() != 7 && hex.size() != 9) return false;
+    rgba[3] = 255;
+    const int channels = (int)(hex.size() - 1) / 2;
+    for (int i = 0; i < channels; ++i){
+        int hi = hex_nibble(hex[1 + 2*i]), lo = hex_nibble(hex[2 + 2*i]);
+        if ((hi | lo) < 0) return false;
+        rgba[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return true;
+}
+
+bool parse_hex_rgba(const std::string& hex, double& r,double& g,double& b,double& a){
+    uint8_t c[4];
+    if (!parse_hex_rgba8(hex, c)) return false;
+    r=c[0]/255.0; g=c[1]/255.0; b=c[2]/255.0; a=c[3]/255.0; return true;
+}
+
+// ---- Batched RGB <-> HSV ----
+// Scalar tails use the same formulation as the SIMD body so results don't depend on n.
+static inline void rgb_to_hsv_1(float r, float g, float b, float& h, float& s, float& v){
+    float mx = std::max(r, std::max(g, b));
+    float mn = std::min(r, std::min(g, b));
+    float d = mx - mn;
+    s = mx > 0.0f ? d / mx : 0.0f;
+    v = mx;
+    if (d <= 0.0f) { h = 0.0f; return; }
+    float t;
+    if (mx == r)      t = (g - b) / d;
+    else if (mx == g) t = (b - r) / d + 2.0f;
+    else              t = (r - g) / d + 4.0f;
+    t *= 60.0f;
+    h = t < 0.0f ? t + 360.0f : t;
+}
+
+// f(n) = v - v*s*max(0, min(k, 4-k, 1)), k = (n + h/60) mod 6  (branch-free form)
+static inline float hsv_channel_1(float n, float h, float s, float v){
+    float k = n + h * (1.0f / 60.0f);
+    if (k >= 6.0f) k -= 6.0f;
+    float t = std::max(0.0f, std::min(std::min(k, 4.0f - k), 1.0f));
+    return v - v * s * t;
+}
+
+#if defined(__SSE2__)
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b){
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#endif
+
+void rgb_to_hsv_batch(const float* r, const float* g, const float* b,
+                      float* h, float* s, float* v, size_t n){
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f), four = _mm_set1_ps(4.0f);
+    const __m128 sixty = _mm_set1_ps(60.0f), full = _mm_set1_ps(360.0f);
+    for (; i + 4 <= n; i += 4){
+        __m128 R = _mm_loadu_ps(r + i), G = _mm_loadu_ps(g + i), B = _mm_loadu_ps(b + i);
+        __m128 mx = _mm_max_ps(R, _mm_max_ps(G, B));
+        __m128 mn = _mm_min_ps(R, _mm_min_ps(G, B));
+        __m128 d  = _mm_sub_ps(mx, mn);
+
+        __m128 has_v = _mm_cmpgt_ps(mx, zero);
+        __m128 has_d = _mm_cmpgt_ps(d, zero);
+        __m128 S = _mm_and_ps(has_v, _mm_div_ps(d, select_ps(has_v, mx, one)));
+
+        __m128 inv_d = _mm_div_ps(one, select_ps(has_d, d, one));
+        __m128 hr = _mm_mul_ps(_mm_sub_ps(G, B), inv_d);
+        __m128 hg = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(B, R), inv_d), two);
+        __m128 hb = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(R, G), inv_d), four);
+        __m128 t  = select_ps(_mm_cmpeq_ps(mx, R), hr, select_ps(_mm_cmpeq_ps(mx, G), hg, hb));
+        t = _mm_mul_ps(t, sixty);
+        t = _mm_add_ps(t, _mm_and_ps(_mm_cmplt_ps(t, zero), full));
+        t = _mm_and_ps(has_d, t);
+
+        _mm_storeu_ps(h + i, t);
+        _mm_storeu_ps(s + i, S);
+        _mm_storeu_ps(v + i, mx);
+    }
+#endif
+    for (; i < n; ++i) rgb_to_hsv_1(r[i], g[i], b[i], h[i], s[i], v[i]);
+}
+
+void hsv_to_rgb_batch(const float* h, const float* s, const float* v,
+                      float* r, float* g, float* b, size_t n){
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 four = _mm_set1_ps(4.0f), six = _mm_set1_ps(6.0f);
+    const __m128 inv60 = _mm_set1_ps(1.0f / 60.0f);
+    const __m128 n5 = _mm_set1_ps(5.0f), n3 = _mm_set1_ps(3.0f), n1 = one;
+    for (; i + 4 <= n; i += 4){
+        __m128 H = _mm_mul_ps(_mm_loadu_ps(h + i), inv60);
+        __m128 S = _mm_loadu_ps(s + i), V = _mm_loadu_ps(v + i);
+        __m128 C = _mm_mul_ps(V, S);
+
+        auto channel = [&](__m128 off){
+            __m128 k = _mm_add_ps(off, H);
+            k = _mm_sub_ps(k, _mm_and_ps(_mm_cmpge_ps(k, six), six));
+            __m128 t = _mm_min_ps(_mm_min_ps(k, _mm_sub_ps(four, k)), one);
+            t = _mm_max_ps(t, zero);
+            return _mm_sub_ps(V, _mm_mul_ps(C, t));
+        };
+        _mm_storeu_ps(r + i, channel(n5));
+        _mm_storeu_ps(g + i, channel(n3));
+        _mm_storeu_ps(b + i, channel(n1));
+    }
+#endif
+    for (; i < n; ++i){
+        float H = h[i], S = s[i], V = v[i];
+        r[i] = hsv_channel_1(5.0f, H, S, V);
+        g[i] = hsv_channel_1(3.0f, H, S, V);
+        b[i] = hsv_channel_1(1.0f, H, S, V);
+    }
+}
+
+// ---- Premultiply / unpremultiply ----
+struct AlphaLuts {
+    float    recip[256];    // 1/a (0 for a == 0)
+    uint32_t recip16[256];  // round(255 * 65536 / a), for 8-bit unpremultiply
+    AlphaLuts(){
+        recip[0] = 0.0f; recip16[0] = 0;
+        for (int a = 1; a < 256; ++a){
+            recip[a] = 1.0f / (float)a;
+            recip16[a] = (uint32_t)((255u * 65536u + a / 2) / a);
+        }
+    }
+};
+static const AlphaLuts g_alpha_luts;
+
+void unpremultiply_argb32(const uint32_t* px, float* r, float* g, float* b, float* a, size_t n){
+    const float* recip = g_alpha_luts.recip;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i mask8 = _mm_set1_epi32(0xFF);
+    const __m128 inv255 = _mm_set1_ps(1.0f / 255.0f);
+    for (; i + 4 <= n; i += 4){
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(px + i));
+        __m128 A = _mm_cvtepi32_ps(_mm_srli_epi32(p, 24));
+        __m128 R = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), mask8));
+        __m128 G = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), mask8));
+        __m128 B = _mm_cvtepi32_ps(_mm_and_si128(p, mask8));
+        // No gather in SSE2: four scalar LUT loads, then vector multiplies
+        __m128 ra = _mm_setr_ps(recip[px[i] >> 24], recip[px[i+1] >> 24],
+                                recip[px[i+2] >> 24], recip[px[i+3] >> 24]);
+        _mm_storeu_ps(r + i, _mm_mul_ps(R, ra));
+        _mm_storeu_ps(g + i, _mm_mul_ps(G, ra));
+        _mm_storeu_ps(b + i, _mm_mul_ps(B, ra));
+        _mm_storeu_ps(a + i, _mm_mul_ps(A, inv255));
+    }
+#endif
+    for (; i < n; ++i){
+        uint32_t p = px[i];
+        float ra = recip[p >> 24];
+        r[i] = ((p >> 16) & 0xFF) * ra;
+        g[i] = ((p >> 8) & 0xFF) * ra;
+        b[i] = (p & 0xFF) * ra;
+        a[i] = (p >> 24) * (1.0f / 255.0f);
+    }
+}
+
+void premultiply_argb32(const float* r, const float* g, const float* b, const float* a,
+                        uint32_t* px, size_t n){
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 k255 = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+    for (; i + 4 <= n; i += 4){
+        __m128 A  = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(a + i), zero), one);
+        __m128 A8 = _mm_mul_ps(A, k255);
+        auto pack = [&](const float* c){
+            __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(c + i), zero), one);
+            return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, A8), half));
+        };
+        __m128i P = _mm_slli_epi32(_mm_cvttps_epi32(_mm_add_ps(A8, half)), 24);
+        P = _mm_or_si128(P, _mm_slli_epi32(pack(r), 16));
+        P = _mm_or_si128(P, _mm_slli_epi32(pack(g), 8));
+        P = _mm_or_si128(P, pack(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(px + i), P);
+    }
+#endif
+    for (; i < n; ++i){
+        float A8 = std::min(std::max(a[i], 0.0f), 1.0f) * 255.0f;
+        auto pack = [&](float c){ return (uint32_t)(std::min(std::max(c, 0.0f), 1.0f) * A8 + 0.5f); };
+        px[i] = ((uint32_t)(A8 + 0.5f) << 24) | (pack(r[i]) << 16) | (pack(g[i]) << 8) | pack(b[i]);
+    }
+}
+
+void unpremultiply_argb32_inplace(uint32_t* px, size_t n){
+    const uint32_t* recip16 = g_alpha_luts.recip16;
+    for (size_t i = 0; i < n; ++i){
+        uint32_t p = px[i];
+        uint32_t a = p >> 24;
+        if (a == 0 || a == 255) continue;
+        uint32_t k = recip16[a];
+        auto un = [&](uint32_t c){ return std::min<uint32_t>((c * k + 32768u) >> 16, 255u); };
+        px[i] = (a << 24) | (un((p >> 16) & 0xFF) << 16) | (un((p >> 8) & 0xFF) << 8) | un(p & 0xFF);
+    }
+}
+
+void premultiply_argb32_inplace(uint32_t* px, size_t n){
+    for (size_t i = 0; i < n; ++i){
+        uint32_t p = px[i];
+        uint32_t a = p >> 24;
+        if (a == 255) continue;
+        // exact round(c * a / 255)
+        auto mul = [&](uint32_t c){ uint32_t t = c * a + 128; return (t + (t >> 8)) >> 8; };
+        px[i] = (a << 24) | (mul((p >> 16) & 0xFF) << 16) | (mul((p >> 8) & 0xFF) << 8) | mul(p & 0xFF);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Shared colour math for all tools. Hue is in degrees [0,360); everything else 0..1.
+
+// ---- Scalar helpers ----
+void rgb_to_hsv(double R, double G, double B, double& h, double& s, double& v);
+
+void hsv_to_rgb(double h, double s, double v, double& R, double& G, double& B);
+
+// parse "#RRGGBB" or "#RRGGBBAA" (alpha optional)
+bool parse_hex_rgba(const std::string& hex, double& r, double& g, double& b, double& a);
+
+// Same, straight to 8-bit RGBA
+bool parse_hex_rgba8(const std::string& hex, uint8_t rgba[4]);
+
+// ---- Batched float conversions over planar arrays (SSE2 when available) ----
+// Output may alias input.
+void rgb_to_hsv_batch(const float* r, const float* g, const float* b,
+                      float* h, float* s, float* v, size_t n);
+
+// Hue must be in [0,360].
+void hsv_to_rgb_batch(const float* h, const float* s, const float* v,
+                      float* r, float* g, float* b, size_t n);
+
+// ---- Premultiplied ARGB32 (cairo layout) ----
+// Split into straight-alpha float planes; divides by alpha through a reciprocal LUT.
+void unpremultiply_argb32(const uint32_t* px, float* r, float* g, float* b, float* a, size_t n);
+
+// Pack straight-alpha planes back into premultiplied pixels (colour clamped to 0..1).
+void premultiply_argb32(const float* r, const float* g, const float* b, const float* a,
+                        uint32_t* px, size_t n);
+
+// 8-bit in-place variants
+void unpremultiply_argb32_inplace(uint32_t* px, size_t n);
+void premultiply_argb32_inplace(uint32_t* px, size_t n);
@@ -0,0 +1,186 @@
+// Throughput of color_math.cpp against the scalar code it replaced.
+// Build: g++ -O2 -std=c++17 color_math_bench.cpp color_math.cpp -o color_math_bench
+#include "color_math.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// ---- Previous implementations (recolor_png.cpp / cairo_set_source_rgba.cpp) ----
+static inline void legacy_rgb_to_hsv(double R, double G, double B, double& h, double& s, double& v){
+    double mx = std::fmax(R, std::fmax(G, B));
+    double mn = std::fmin(R, std::fmin(G, B));
+    v = mx; double d = mx - mn; s = (mx == 0 ? 0 : d / mx);
+    if (d == 0) { h = 0; return; }
+    if (mx == R) h = 60.0 * std::fmod(((G - B) / d), 6.0);
+    else if (mx == G) h = 60.0 * (((B - R) / d) + 2.0);
+    else h = 60.0 * (((R - G) / d) + 4.0);
+    if (h < 0) h += 360.0;
+}
+static inline void legacy_hsv_to_rgb(double h, double s, double v, double& R, double& G, double& B){
+    double C = v * s;
+    double X = C * (1 - std::fabs(std::fmod(h/60.0, 2) - 1));
+    double m = v - C;
+    double r=0,g=0,b=0;
+    if (h < 60)      { r=C; g=X; b=0; }
+    else if (h<120 ) { r=X; g=C; b=0; }
+    else if (h<180 ) { r=0; g=C; b=X; }
+    else if (h<240 ) { r=0; g=X; b=C; }
+    else if (h<300 ) { r=X; g=0; b=C; }
+    else             { r=C; g=0; b=X; }
+    R=r+m; G=g+m; B=b+m;
+}
+static bool legacy_parse_hex_rgba(const std::string& hex, double& r,double& g,double& b,double& a){
+    if (hex.empty() || hex[0] != '#') return false;
+    unsigned rv=0,gv=0,bv=0,av=255;
+    if (hex.size()==7)       { if (sscanf(hex.c_str()+1,"%02x%02x%02x",&rv,&gv,&bv)!=3) return false; }
+    else if (hex.size()==9 ) { if (sscanf(hex.c_str()+1,"%02x%02x%02x%02x",&rv,&gv,&bv,&av)!=4) return false; }
+    else return false;
+    r=rv/255.0; g=gv/255.0; b=bv/255.0; a=av/255.0; return true;
+}
+
+// Per-pixel hue shift exactly as hue_shift_png() did it
+static void legacy_hue_shift(uint32_t* px, size_t n, double delta){
+    for (size_t i = 0; i < n; ++i){
+        uint32_t p = px[i];
+        uint8_t a = (p >> 24) & 0xFF, r = (p >> 16) & 0xFF, g = (p >> 8) & 0xFF, b = p & 0xFF;
+        if (a == 0) continue;
+        double R = r/255.0, G = g/255.0, B = b/255.0, A = a/255.0;
+        R /= A; G /= A; B /= A;
+        double h,s,v; legacy_rgb_to_hsv(R,G,B,h,s,v);
+        h = std::fmod(h + delta + 360.0, 360.0);
+        legacy_hsv_to_rgb(h,s,v,R,G,B);
+        R = std::min(std::max(R,0.0),1.0);
+        G = std::min(std::max(G,0.0),1.0);
+        B = std::min(std::max(B,0.0),1.0);
+        uint8_t R8 = (uint8_t)std::round(R * A * 255.0);
+        uint8_t G8 = (uint8_t)std::round(G * A * 255.0);
+        uint8_t B8 = (uint8_t)std::round(B * A * 255.0);
+        px[i] = ((uint32_t)a<<24) | (R8<<16) | (G8<<8) | (B8);
+    }
+}
+
+// Same operation through the batched planar API
+static void batch_hue_shift(uint32_t* px, size_t n, float delta){
+    std::vector<float> r(n), g(n), b(n), a(n);
+    unpremultiply_argb32(px, r.data(), g.data(), b.data(), a.data(), n);
+    rgb_to_hsv_batch(r.data(), g.data(), b.data(), r.data(), g.data(), b.data(), n);
+    for (size_t i = 0; i < n; ++i){
+        float h = r[i] + delta;
+        r[i] = h >= 360.0f ? h - 360.0f : (h < 0.0f ? h + 360.0f : h);
+    }
+    hsv_to_rgb_batch(r.data(), g.data(), b.data(), r.data(), g.data(), b.data(), n);
+    premultiply_argb32(r.data(), g.data(), b.data(), a.data(), px, n);
+}
+
+template <class F>
+static double best_of(int reps, F&& f){
+    double best = 1e30;
+    for (int i = 0; i < reps; ++i){
+        auto t0 = std::chrono::steady_clock::now();
+        f();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+static void report(const char* name, size_t items, double legacy_s, double new_s){
+    std::printf("%-22s legacy %8.1f M/s   new %8.1f M/s   x%.2f\n", name,
+                items / legacy_s / 1e6, items / new_s / 1e6, legacy_s / new_s);
+}
+
+int main(int argc, char** argv){
+    const size_t N = (argc > 1) ? (size_t)std::atoll(argv[1]) : (size_t)1 << 20;
+    std::mt19937 rng(1234);
+
+    // Valid premultiplied pixels
+    std::vector<uint32_t> src(N);
+    for (auto& p : src){
+        uint32_t a = rng() & 0xFF;
+        auto c = [&]{ return a ? (uint32_t)(rng() % (a + 1)) : 0u; };
+        p = (a << 24) | (c() << 16) | (c() << 8) | c();
+    }
+
+    // HSV round trip on straight planes
+    std::vector<float> r(N), g(N), b(N), a(N), h(N), s(N), v(N);
+    unpremultiply_argb32(src.data(), r.data(), g.data(), b.data(), a.data(), N);
+    volatile double sink = 0;
+    double t_old = best_of(5, [&]{
+        double acc = 0;
+        for (size_t i = 0; i < N; ++i){
+            double H,S,V,R,G,B;
+            legacy_rgb_to_hsv(r[i], g[i], b[i], H, S, V);
+            legacy_hsv_to_rgb(H, S, V, R, G, B);
+            acc += R + G + B;
+        }
+        sink = acc;
+    });
+    double t_new = best_of(5, [&]{
+        rgb_to_hsv_batch(r.data(), g.data(), b.data(), h.data(), s.data(), v.data(), N);
+        hsv_to_rgb_batch(h.data(), s.data(), v.data(), h.data(), s.data(), v.data(), N);
+        sink = h[N/2];
+    });
+    report("rgb->hsv->rgb", N, t_old, t_new);
+
+    // Max round-trip error of the float path
+    float max_err = 0;
+    for (size_t i = 0; i < N; ++i)
+        max_err = std::max({ max_err, std::fabs(h[i] - r[i]), std::fabs(s[i] - g[i]), std::fabs(v[i] - b[i]) });
+    std::printf("%-22s max |rgb - rgb'| = %.2e\n", "", max_err);
+
+    // Unpremultiply: per-pixel divide vs reciprocal LUT
+    t_old = best_of(5, [&]{
+        for (size_t i = 0; i < N; ++i){
+            uint32_t p = src[i];
+            double A = (p >> 24) / 255.0;
+            double R = ((p >> 16) & 0xFF) / 255.0, G = ((p >> 8) & 0xFF) / 255.0, B = (p & 0xFF) / 255.0;
+            if (A > 0) { R /= A; G /= A; B /= A; }
+            r[i] = (float)R; g[i] = (float)G; b[i] = (float)B; a[i] = (float)A;
+        }
+    });
+    t_new = best_of(5, [&]{ unpremultiply_argb32(src.data(), r.data(), g.data(), b.data(), a.data(), N); });
+    report("unpremultiply", N, t_old, t_new);
+
+    // Full hue shift pass
+    std::vector<uint32_t> px_old = src, px_new = src;
+    t_old = best_of(3, [&]{ px_old = src; legacy_hue_shift(px_old.data(), N, 40.0); });
+    t_new = best_of(3, [&]{ px_new = src; batch_hue_shift(px_new.data(), N, 40.0f); });
+    report("hue shift (40 deg)", N, t_old, t_new);
+
+    size_t off_by_more = 0;
+    for (size_t i = 0; i < N; ++i){
+        for (int sh = 0; sh < 32; sh += 8){
+            int d = (int)((px_old[i] >> sh) & 0xFF) - (int)((px_new[i] >> sh) & 0xFF);
+            if (d > 1 || d < -1) { ++off_by_more; break; }
+        }
+    }
+    std::printf("%-22s pixels differing by >1 LSB: %zu\n", "", off_by_more);
+
+    // Hex parsing
+    std::vector<std::string> hexes(1 << 16);
+    for (auto& s : hexes){
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), (rng() & 1) ? "#%06X" : "#%08X", (unsigned)(rng() & 0xFFFFFFFFu));
+        s = buf;
+    }
+    t_old = best_of(5, [&]{
+        double acc = 0, R, G, B, A;
+        for (auto& s : hexes) if (legacy_parse_hex_rgba(s, R, G, B, A)) acc += R + A;
+        sink = acc;
+    });
+    t_new = best_of(5, [&]{
+        double acc = 0, R, G, B, A;
+        for (auto& s : hexes) if (parse_hex_rgba(s, R, G, B, A)) acc += R + A;
+        sink = acc;
+    });
+    report("parse_hex_rgba", hexes.size(), t_old, t_new);
+
+    (void)sink;
+    return 0;
+}
@@ -3,12 +3,30 @@
 #include <iostream>
 #include <sstream>
 #include <limits>
+#include <filesystem>
+#include <thread>
+#include <cstdlib>
+#include <memory>
+#include <chrono>
+#include <fstream>
+#include <atomic>
+#include <mutex>
 #include <cairo.h>
 #include "countdown_timer.hpp"
 #include "rsvg_render.hpp"
+#include "layer_cache.hpp"
+#include "nine_slice.hpp"
+#include "asset_prewarm.hpp"
+#include "sdf_glyph.hpp"
+#include "animated_output.hpp"
+#include "frame_server.hpp"
+#include "trace.hpp"
+#include "surface_pool.hpp"
+#include "asset_watcher.hpp"
+#include "frame_scheduler.hpp"
 
 // Format time as MM:SS
-static std::string formatTime(int min, int sec) {
+std::string formatTime(int min, int sec) {
     std::ostringstream oss;
     if (min < 10) oss << '0';
     oss << min << ':';
@@ -17,18 +35,154 @@ static std::string formatTime(int min, int sec) {
     return oss.str();
 }
 
+// Live mode renders this many seconds ahead of the one on screen
+static const size_t kRenderAheadFrames = 3;
+
 // Map a single character to its SVG path inside chars/
-static std::string getSvgPathForChar(char c) {
+std::string getSvgPathForChar(char c) {
     if (c == ':') return "chars/colon.svg";
     return std::string("chars/") + c + ".svg";
 }
 
 // Map a border choice to an SVG path inside border/
-static std::string getSvgPathForCountdownTimerBorder(const std::string& name) {
+std::string getSvgPathForCountdownTimerBorder(const std::string& name) {
     return std::string("border/") + name + ".svg";
 }
 
+// Glyph surface for a character, shared through the layer cache (caller destroys).
+// With an SDF atlas the glyph is sampled from its distance field instead of the SVG.
+static cairo_surface_t* loadGlyph(char c, int width, int height, const SdfAtlas* sdf = nullptr) {
+    const std::string path = getSvgPathForChar(c);
+    if (sdf && sdf->glyphs.count(c)) {
+        // find/put rather than get: the atlas is local to countdownTimer, so the cache
+        // must not keep a render function pointing at it. An SVG edit drops the entry
+        // and the serve loop rebuilds the atlas cell (sdf_atlas_update_glyph).
+        const LayerKey key { path, "sdf", width, height };
+        if (cairo_surface_t* cached = layer_cache_find(key)) return cached;
+        cairo_surface_t* s = sdf_render_glyph(*sdf, c, width, height);
+        if (s) layer_cache_put(key, s);
+        return s;
+    }
+    return layer_cache_get({ path, "", width, height },
+                           [path](int w, int h) { return renderSvgToSurface(path, w, h); });
+}
+
+// Where the pieces of a frame go on the canvas
+struct CountdownFrameLayout {
+    int canvas_width;
+    int title_y;
+    int digits_y;
+    int char_width;
+    int digit_width;
+    int spacing;
+};
+
+// Width of a row of n items with spacing between them
+static int rowWidth(size_t n, int item_width, int spacing) {
+    return n ? (int)n * item_width + (int)(n - 1) * spacing : 0;
+}
+
+// Clear the canvas and draw border, title row and digit row (both centered)
+static void drawCountdownFrame(cairo_t* cr, const CountdownFrameLayout& L, cairo_surface_t* border_surface,
+                               const std::vector<cairo_surface_t*>& title_surfaces,
+                               const std::vector<cairo_surface_t*>& digit_surfaces) {
+    TRACE_SCOPE("countdown.compose");
+    TRACE_BYTES((uint64_t)cairo_image_surface_get_stride(cairo_get_target(cr)) *
+                cairo_image_surface_get_height(cairo_get_target(cr)));
+
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+    // Draw border background first
+    if (border_surface) {
+        cairo_set_source_surface(cr, border_surface, 0, 0);
+        cairo_paint(cr);
+    }
+
+    // Draw title characters centered horizontally
+    int title_x = (L.canvas_width - rowWidth(title_surfaces.size(), L.char_width, L.spacing)) / 2;
+    for (auto* s : title_surfaces) {
+        if (s) {
+            cairo_set_source_surface(cr, s, title_x, L.title_y);
+            cairo_paint(cr);
+        }
+        title_x += L.char_width + L.spacing;
+    }
+
+    // Draw digits centered horizontally
+    int digits_x = (L.canvas_width - rowWidth(digit_surfaces.size(), L.digit_width, L.spacing)) / 2;
+    for (auto* s : digit_surfaces) {
+        if (s) {
+            cairo_set_source_surface(cr, s, digits_x, L.digits_y);
+            cairo_paint(cr);
+        }
+        digits_x += L.digit_width + L.spacing;
+    }
+}
+
+// Publish 0-9 and ':' side by side as /sprites.png, with x offsets in /sprites.json,
+// so a browser source loads one image instead of one SVG per digit
+static void publishDigitSprites(FrameServer& server, int digit_width, int digit_height, int spacing,
+                                const SdfAtlas* sdf) {
+    const std::string glyphs = "0123456789:";
+    const int sheet_width = rowWidth(glyphs.size(), digit_width, spacing);
+    cairo_surface_t* sheet = surface_pool_acquire(sheet_width, digit_height);
+    cairo_t* cr = cairo_create(sheet);
+
+    std::ostringstream json;
+    json << "{\"width\":" << digit_width << ",\"height\":" << digit_height << ",\"glyphs\":{";
+    int x = 0;
+    for (size_t i = 0; i < glyphs.size(); ++i) {
+        if (cairo_surface_t* g = loadGlyph(glyphs[i], digit_width, digit_height, sdf)) {
+            cairo_set_source_surface(cr, g, x, 0);
+            cairo_paint(cr);
+            cairo_surface_destroy(g);
+        }
+        json << (i ? "," : "") << "\"" << glyphs[i] << "\":" << x;
+        x += digit_width + spacing;
+    }
+    json << "}}";
+
+    cairo_destroy(cr);
+    server.publish("/sprites.png", "image/png", surfaceToPngBytes(sheet));
+    server.publish("/sprites.json", "application/json", json.str());
+    cairo_surface_destroy(sheet);
+}
+
 void countdownTimer() {
+    // ---- Sizes/Layout (tweak as you like) ----
+    const int border_margin = 20;
+    const int border_ref_size = 128;  // nine-slice border reference raster (corners = border_margin)
+    const int spacing       = 10;
+
+    const int digit_width   = 100;
+    const int digit_height  = 150;
+
+    const int char_width    = 40;   // title character size
+    const int char_height   = 60;
+    const int title_y       = border_margin;
+    const int digits_y      = border_margin + char_height + 20;
+
+    // ---- Optional pre-warm ----
+    // COUNTDOWN_PREWARM=1 rasterizes every glyph (and nine-slice border) at the sizes
+    // above on all cores while the prompts below wait for input. COUNTDOWN_ATLAS=<file>
+    // loads them from a prebuilt atlas instead, rendering only what the atlas lacks
+    // (new or edited SVGs) and rewriting it when anything was missing.
+    const char* atlas_env = std::getenv("COUNTDOWN_ATLAS");
+    const char* prewarm_env = std::getenv("COUNTDOWN_PREWARM");
+    std::thread prewarm_thread;
+    if (atlas_env || (prewarm_env && std::string(prewarm_env) != "0")) {
+        const std::string atlas_path = atlas_env ? atlas_env : "";
+        prewarm_thread = std::thread([=]() {
+            const std::vector<PrewarmSet> sets = {
+                { "chars",  { { char_width, char_height }, { digit_width, digit_height } }, ".svg", "", nullptr },
+                { "border", { { border_ref_size, border_ref_size } }, ".9.svg", "", nullptr },
+            };
+            prewarm_with_atlas(atlas_path, sets);
+        });
+    }
+
     // ---- Input ----
     int minutes = 0, seconds = 0;
     std::string title;
@@ -49,35 +203,37 @@ void countdownTimer() {
     std::cout << "Enter border color (e.g. blue): ";
     std::getline(std::cin, border_choice);
 
-    // ---- Build strings ----
-    const std::string time_string = formatTime(minutes, seconds);
-
-    // ---- Sizes/Layout (tweak as you like) ----
-    const int border_margin = 20;
-    const int spacing       = 10;
+    if (prewarm_thread.joinable()) prewarm_thread.join();
 
-    const int digit_width   = 100;
-    const int digit_height  = 150;
+    // ---- Optional SDF glyphs ----
+    // COUNTDOWN_SDF=<atlas file> draws glyphs from a distance-field atlas built once
+    // from chars/ (and rebuilt when an SVG there changes), so any glyph size is cheap.
+    SdfAtlas sdf_atlas;
+    const SdfAtlas* sdf = nullptr;
+    const char* sdf_env = std::getenv("COUNTDOWN_SDF");
+    if (sdf_env) {
+        if (!sdf_atlas_load(sdf_atlas, sdf_env, "chars")) {
+            sdf_atlas = sdf_atlas_build("chars");
+            if (!sdf_atlas.glyphs.empty()) sdf_atlas_save(sdf_atlas, sdf_env);
+        }
+        if (!sdf_atlas.glyphs.empty()) sdf = &sdf_atlas;
+    }
 
-    const int char_width    = 40;   // title character size
-    const int char_height   = 60;
-    const int title_y       = border_margin;
-    const int digits_y      = border_margin + char_height + 20;
+    // ---- Build strings ----
+    const std::string time_string = formatTime(minutes, seconds);
 
     // ---- Render title characters to surfaces ----
     std::vector<cairo_surface_t*> title_surfaces;
     title_surfaces.reserve(title.size());
     for (char c : title) {
-        auto s = renderSvgToSurface(getSvgPathForChar(c), char_width, char_height);
-        title_surfaces.push_back(s);
+        title_surfaces.push_back(loadGlyph(c, char_width, char_height, sdf));
     }
 
     // ---- Render digits to surfaces ----
     std::vector<cairo_surface_t*> digit_surfaces;
     digit_surfaces.reserve(time_string.size());
     for (char c : time_string) {
-        auto s = renderSvgToSurface(getSvgPathForChar(c), digit_width, digit_height);
-        digit_surfaces.push_back(s);
+        digit_surfaces.push_back(loadGlyph(c, digit_width, digit_height, sdf));
     }
 
     // ---- Border surface (scaled big enough to cover everything) ----
@@ -91,46 +247,176 @@ void countdownTimer() {
     const int canvas_width   = content_width + 2 * border_margin;
     const int canvas_height  = digits_y + digit_height + border_margin;
 
-    cairo_surface_t* border_surface =
-        renderSvgToSurface(getSvgPathForCountdownTimerBorder(border_choice), canvas_width, canvas_height);
+    // Border only depends on (asset, size), so it is rasterized once and reused.
+    // A nine-slice variant (border/<name>.9.svg) is rasterized once at a reference
+    // size and stretched to any canvas, so new title lengths don't re-render the SVG.
+    const std::string border_path = getSvgPathForCountdownTimerBorder(border_choice);
+    const std::string border_9_path = nineSlicePathFor(border_path);
+    auto loadBorder = [=]() -> cairo_surface_t* {
+        if (std::filesystem::exists(border_9_path)) {
+            return layer_cache_get(
+                { border_9_path, "nine-slice", canvas_width, canvas_height },
+                [=](int w, int h) {
+                    NineSliceInsets insets;
+                    insets.left = insets.top = insets.right = insets.bottom = border_margin;
+                    NineSlice ns = nine_slice_load(border_9_path, border_ref_size, border_ref_size, insets);
+                    cairo_surface_t* s = nine_slice_compose(ns, w, h);
+                    nine_slice_free(ns);
+                    return s;
+                });
+        }
+        return layer_cache_get(
+            { border_path, "", canvas_width, canvas_height },
+            // Full-canvas border: the one render here big enough to tile across cores
+            [=](int w, int h) { return renderSvgToSurface(border_path, w, h, 0); });
+    };
+    cairo_surface_t* border_surface = loadBorder();
 
     // ---- Create final canvas ----
-    cairo_surface_t* canvas = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, canvas_width, canvas_height);
+    // Pooled: drawCountdownFrame clears it, so skip the zero fill
+    cairo_surface_t* canvas = surface_pool_acquire(canvas_width, canvas_height, false);
     cairo_t* cr = cairo_create(canvas);
 
-    // Draw border background first
-    if (border_surface) {
-        cairo_set_source_surface(cr, border_surface, 0, 0);
-        cairo_paint(cr);
-    }
+    const CountdownFrameLayout layout { canvas_width, title_y, digits_y, char_width, digit_width, spacing };
 
-    // Draw title characters centered horizontally
-    int title_total_width = title_row_width;
-    int title_x = (canvas_width - title_total_width) / 2;
-    for (auto* s : title_surfaces) {
-        cairo_set_source_surface(cr, s, title_x, title_y);
-        cairo_paint(cr);
-        title_x += char_width + spacing;
-    }
+    // COUNTDOWN_ANIMATE=apng|webp writes every second from the entered time down to
+    // 00:00 as one animation; only the changed digit region is stored per frame.
+    const char* animate_env = std::getenv("COUNTDOWN_ANIMATE");
+    if (animate_env) {
+        const std::string format = animate_env;
+        const std::string out_path = format == "webp" ? "countdown_output.webp" : "countdown_output.png";
+        std::unique_ptr<AnimWriter> writer = makeAnimWriter(format);
+        if (writer && writer->open(out_path, canvas_width, canvas_height)) {
+            int frames = 0;
+            for (int t = minutes * 60 + seconds; t >= 0; --t) {
+                std::vector<cairo_surface_t*> frame_digits;
+                for (char c : formatTime(t / 60, t % 60))
+                    frame_digits.push_back(loadGlyph(c, digit_width, digit_height, sdf));
 
-    // Draw digits centered horizontally
-    int digits_total_width = digits_row_width;
-    int digits_x = (canvas_width - digits_total_width) / 2;
-    for (auto* s : digit_surfaces) {
-        cairo_set_source_surface(cr, s, digits_x, digits_y);
-        cairo_paint(cr);
-        digits_x += digit_width + spacing;
-    }
+                drawCountdownFrame(cr, layout, border_surface, title_surfaces, frame_digits);
+                writer->addFrame(canvas, 1000);
+                ++frames;
+
+                for (auto* s : frame_digits) if (s) cairo_surface_destroy(s);
+            }
+            if (writer->close())
+                std::cout << "Wrote " << out_path << " (" << frames << " frames, "
+                          << canvas_width << "x" << canvas_height << ")\n";
+        }
+    } else if (const char* serve_env = std::getenv("COUNTDOWN_SERVE")) {
+        // COUNTDOWN_SERVE=<port> serves the live frame on localhost for a browser source:
+        // /frame.png (ETag/304), /events (SSE), /stream (multipart PNG), /sprites.png+.json
+        FrameServer server;
+        const int port = std::atoi(serve_env);
+        if (server.start(port)) {
+            publishDigitSprites(server, digit_width, digit_height, spacing, sdf);
+            std::ifstream page("index.html", std::ios::binary);
+            if (page) {
+                std::ostringstream html;
+                html << page.rdbuf();
+                server.publish("/", "text/html; charset=utf-8", html.str());
+            }
+            std::cout << "Serving on http://127.0.0.1:" << port << "/\n";
+
+            // Edits to chars/ or border/ are re-rasterized in the background; the next
+            // frame picks them up from the layer cache without a restart
+            // In SDF mode glyphs come from the atlas, so changed chars/ SVGs are also
+            // queued for the render thread to rebuild their cells before the next frame
+            std::atomic<bool> assets_changed{false};
+            std::mutex changed_mutex;
+            std::vector<std::string> changed_glyphs;
+            AssetWatcher watcher;
+            watcher.start({ "chars", "border" }, [&](const std::string& path, size_t) {
+                std::cout << "Reloaded " << path << "\n";
+                if (sdf && path.compare(0, 6, "chars/") == 0) {
+                    std::lock_guard<std::mutex> lock(changed_mutex);
+                    changed_glyphs.push_back(path);
+                }
+                assets_changed = true;
+            });
+
+            // Frames are rendered and PNG-encoded ahead on a worker and released exactly
+            // on wall-clock second boundaries, so load/encode spikes never show as jitter
+            const auto wall_now = std::chrono::system_clock::now();
+            auto to_boundary = std::chrono::seconds(1) -
+                std::chrono::duration_cast<std::chrono::nanoseconds>(wall_now.time_since_epoch()) % std::chrono::seconds(1);
+            if (to_boundary < std::chrono::milliseconds(200)) to_boundary += std::chrono::seconds(1);  // time to pre-render
+            const auto start = std::chrono::steady_clock::now() + to_boundary;
 
-    // ---- Save and cleanup ----
-    cairo_surface_write_to_png(canvas, "countdown_output.png");
+            const int total = minutes * 60 + seconds;
+            FrameScheduler scheduler(kRenderAheadFrames);
+            const FrameScheduler::Stats stats = scheduler.run(
+                total + 1, start, std::chrono::seconds(1),
+                [&](int i) {
+                    const int t = total - i;
+                    if (assets_changed.exchange(false)) {
+                        std::vector<std::string> glyph_paths;
+                        {
+                            std::lock_guard<std::mutex> lock(changed_mutex);
+                            glyph_paths.swap(changed_glyphs);
+                        }
+                        bool atlas_changed = false;
+                        for (const std::string& path : glyph_paths) {
+                            if (!sdf_atlas_update_glyph(sdf_atlas, path)) continue;
+                            // A frame may have re-cached the old cell after the watcher dropped it
+                            layer_cache_invalidate_asset(path);
+                            atlas_changed = true;
+                        }
+                        if (atlas_changed) sdf_atlas_save(sdf_atlas, sdf_env);
+                        if (border_surface) cairo_surface_destroy(border_surface);
+                        border_surface = loadBorder();
+                        for (auto*& s : title_surfaces) {
+                            if (s) cairo_surface_destroy(s);
+                            s = nullptr;
+                        }
+                        for (size_t k = 0; k < title.size(); ++k)
+                            title_surfaces[k] = loadGlyph(title[k], char_width, char_height, sdf);
+                        publishDigitSprites(server, digit_width, digit_height, spacing, sdf);
+                    }
+                    std::vector<cairo_surface_t*> frame_digits;
+                    for (char c : formatTime(t / 60, t % 60))
+                        frame_digits.push_back(loadGlyph(c, digit_width, digit_height, sdf));
+                    drawCountdownFrame(cr, layout, border_surface, title_surfaces, frame_digits);
+                    for (auto* s : frame_digits) if (s) cairo_surface_destroy(s);
+                    return surfaceToPngBytes(canvas);
+                },
+                [&](int, const std::string& png) { server.publishFrame(png); });
 
+            std::cout << "Published " << stats.published << " frames: " << stats.missed
+                      << " missed deadlines (worst " << stats.max_late_ms << " ms late), "
+                      << stats.dropped << " stale frames dropped; render avg "
+                      << stats.avg_render_ms << " ms, max " << stats.max_render_ms << " ms\n";
+
+            std::cout << "Countdown finished; press Enter to stop serving\n";
+            std::string line;
+            std::getline(std::cin, line);
+            watcher.stop();
+            server.stop();
+        }
+    } else {
+        drawCountdownFrame(cr, layout, border_surface, title_surfaces, digit_surfaces);
+
+        // ---- Save ----
+        {
+            TRACE_SCOPE("png.encode");
+            TRACE_BYTES((uint64_t)cairo_image_surface_get_stride(canvas) * canvas_height);
+            cairo_surface_write_to_png(canvas, "countdown_output.png");
+        }
+        std::cout << "Wrote countdown_output.png (" << canvas_width << "x" << canvas_height << ")\n";
+    }
+
+    // ---- Cleanup ----
     cairo_destroy(cr);
     cairo_surface_destroy(canvas);
     if (border_surface) cairo_surface_destroy(border_surface);
     for (auto* s : title_surfaces) cairo_surface_destroy(s);
     for (auto* s : digit_surfaces) cairo_surface_destroy(s);
 
-    std::cout << "Wrote countdown_output.png (" << canvas_width << "x" << canvas_height << ")\n";
-    return 0;
+    // COUNTDOWN_POOL_STATS=1 reports pixel buffer reuse (layer-cached glyphs stay in use)
+    if (std::getenv("COUNTDOWN_POOL_STATS")) {
+        const SurfacePoolStats ps = surface_pool_stats();
+        std::cout << "Surface pool: " << ps.in_use_bytes / 1024 << " KB in use, "
+                  << ps.idle_bytes / 1024 << " KB idle, peak " << ps.peak_bytes / 1024 << " KB, "
+                  << ps.hits << " reused / " << ps.misses << " allocated\n";
+    }
 }
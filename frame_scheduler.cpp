@@ -0,0 +1,102 @@
+#include "frame_scheduler.hpp"
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+using Ms = std::chrono::duration<double, std::milli>;
+
+FrameScheduler::Stats FrameScheduler::run(int frames, Clock::time_point start, Clock::duration interval,
+                                          const RenderFn& render, const PublishFn& publish) {
+    Stats stats;
+    queue_.clear();
+    worker_done_ = false;
+    stopping_ = false;
+    if (frames <= 0) return stats;
+
+    auto deadline = [&](int i) { return start + interval * i; };
+    // Index of the newest frame whose deadline has passed (-1 before start)
+    auto due_index = [&](Clock::time_point now) {
+        if (now < start) return -1;
+        return (int)std::min<long long>(frames - 1, (now - start) / interval);
+    };
+
+    double render_total_ms = 0.0;
+    int skipped = 0;
+    std::exception_ptr render_error;
+
+    std::thread worker([&] {
+        try {
+            for (int i = 0; i < frames; ++i) {
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    cv_.wait(lk, [&] { return queue_.size() < depth_ || stopping_; });
+                    if (stopping_) break;
+                }
+                // Behind schedule: jump to the frame that is due now instead of rendering stale ones
+                const int due = due_index(Clock::now());
+                if (i < due) {
+                    skipped += due - i;
+                    i = due;
+                }
+
+                const auto t0 = Clock::now();
+                std::string data = render(i);
+                const double ms = Ms(Clock::now() - t0).count();
+                render_total_ms += ms;
+                stats.max_render_ms = std::max(stats.max_render_ms, ms);
+                ++stats.rendered;
+
+                std::lock_guard<std::mutex> lk(mutex_);
+                queue_.push_back({ i, std::move(data) });
+                cv_.notify_all();
+            }
+        } catch (...) {
+            render_error = std::current_exception();
+        }
+        // Always reached, so the publisher never waits on a worker that is gone
+        std::lock_guard<std::mutex> lk(mutex_);
+        worker_done_ = true;
+        cv_.notify_all();
+    });
+
+    try {
+        for (;;) {
+            Frame f;
+            {
+                std::unique_lock<std::mutex> lk(mutex_);
+                cv_.wait(lk, [&] { return !queue_.empty() || worker_done_; });
+                if (queue_.empty()) break;
+                f = std::move(queue_.front());
+                queue_.pop_front();
+                cv_.notify_all();  // room for the worker
+            }
+
+            // A frame is stale once the next one is due; the last frame never is
+            if (f.index + 1 < frames && Clock::now() >= deadline(f.index + 1)) {
+                ++stats.dropped;
+                continue;
+            }
+
+            std::this_thread::sleep_until(deadline(f.index));
+            const double late_ms = Ms(Clock::now() - deadline(f.index)).count();
+            publish(f.index, f.data);
+            ++stats.published;
+            stats.max_late_ms = std::max(stats.max_late_ms, late_ms);
+            if (late_ms > tolerance_.count()) ++stats.missed;
+        }
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            stopping_ = true;
+            cv_.notify_all();
+        }
+        worker.join();
+        throw;
+    }
+    worker.join();
+    if (render_error) std::rethrow_exception(render_error);
+
+    stats.dropped += skipped;
+    stats.avg_render_ms = stats.rendered ? render_total_ms / stats.rendered : 0.0;
+    return stats;
+}
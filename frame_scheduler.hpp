@@ -0,0 +1,56 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// Real-time frame pacing: a worker thread renders upcoming frames into a bounded
+// queue while the calling thread releases each one at its steady_clock deadline
+// (start + index * interval). Slow renders or encodes are absorbed by the queue
+// instead of delaying the on-screen frame. If the renderer falls behind, frames
+// whose successor is already due are dropped rather than shown late.
+class FrameScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Render frame `index` and return its encoded bytes (runs on the worker thread)
+    using RenderFn = std::function<std::string(int index)>;
+    // Show frame `index` (runs on the calling thread, at the deadline)
+    using PublishFn = std::function<void(int index, const std::string& frame)>;
+
+    struct Stats {
+        int rendered  = 0;
+        int published = 0;
+        int missed    = 0;   // published later than the tolerance
+        int dropped   = 0;   // never shown: stale in the queue or skipped by the renderer
+        double max_late_ms   = 0.0;
+        double max_render_ms = 0.0;
+        double avg_render_ms = 0.0;
+    };
+
+    explicit FrameScheduler(size_t queue_depth = 3,
+                            std::chrono::milliseconds late_tolerance = std::chrono::milliseconds(15))
+        : depth_(queue_depth ? queue_depth : 1), tolerance_(late_tolerance) {}
+
+    // Frames 0..frames-1; blocks until the last one is published. An exception from
+    // render (after the frames already queued are shown) or from publish stops both
+    // threads and is rethrown here.
+    Stats run(int frames, Clock::time_point start, Clock::duration interval,
+              const RenderFn& render, const PublishFn& publish);
+
+private:
+    struct Frame {
+        int index;
+        std::string data;
+    };
+
+    size_t depth_;
+    std::chrono::milliseconds tolerance_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Frame> queue_;
+    bool worker_done_ = false;
+    bool stopping_ = false;   // publisher failed: worker exits at its next wait
+};
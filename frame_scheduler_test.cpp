@@ -0,0 +1,174 @@
+// FrameScheduler against a fake renderer: on-time frames, a render slow enough to
+// publish one frame late, one slow enough that frames are dropped and skipped, and
+// exceptions from render and from publish, which must reach the caller only after
+// the worker has been joined. Timings leave 20 ms or more either side of each
+// deadline that decides a count.
+// Build: g++ -O2 -std=c++17 frame_scheduler_test.cpp frame_scheduler.cpp -pthread -o frame_scheduler_test
+#include "frame_scheduler.hpp"
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+static int g_failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    if (ok) return;
+    ++g_failures;
+    if (g_failures <= 20) std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+}
+
+// Renders "frame <i>" after the delay given for that index, counting calls
+struct FakeRenderer {
+    std::vector<milliseconds> delay;   // per index; missing means instant
+    int throw_at = -1;
+    std::atomic<int> calls{0};
+    std::atomic<bool> in_render{false};
+
+    std::string operator()(int i) {
+        in_render = true;
+        ++calls;
+        if (i < (int)delay.size()) std::this_thread::sleep_for(delay[i]);
+        in_render = false;
+        if (i == throw_at) throw std::runtime_error("render failed at " + std::to_string(i));
+        return "frame " + std::to_string(i);
+    }
+};
+
+// Records what was shown and when; throws at `throw_at`
+struct Publisher {
+    FrameScheduler::Clock::time_point start;
+    milliseconds interval;
+    int throw_at = -1;
+    std::vector<int> shown;
+    bool early = false, mismatched = false;
+
+    void operator()(int i, const std::string& frame) {
+        if (i == throw_at) throw std::runtime_error("publish failed at " + std::to_string(i));
+        early |= FrameScheduler::Clock::now() < start + interval * i;
+        mismatched |= frame != "frame " + std::to_string(i);
+        shown.push_back(i);
+    }
+};
+
+static std::string indices(const std::vector<int>& v) {
+    std::string s;
+    for (int i : v) s += (s.empty() ? "" : ",") + std::to_string(i);
+    return s;
+}
+
+static FrameScheduler::Stats run(FrameScheduler& sched, int frames, milliseconds interval,
+                                 FakeRenderer& render, Publisher& publish) {
+    publish.start = FrameScheduler::Clock::now() + milliseconds(30);
+    publish.interval = interval;
+    return sched.run(frames, publish.start, interval,
+                     [&](int i) { return render(i); },
+                     [&](int i, const std::string& f) { publish(i, f); });
+}
+
+int main() {
+    // Every render well inside its interval: all shown, in order, none early
+    {
+        FrameScheduler sched(3, milliseconds(100));
+        FakeRenderer render;
+        render.delay.assign(8, milliseconds(2));
+        Publisher publish;
+        const auto st = run(sched, 8, milliseconds(20), render, publish);
+        check(st.rendered == 8 && st.published == 8 && st.dropped == 0 && st.missed == 0, "on time: counts");
+        check(indices(publish.shown) == "0,1,2,3,4,5,6,7", "on time: order " + indices(publish.shown));
+        check(!publish.early && !publish.mismatched, "on time: deadlines and payloads");
+        check(st.avg_render_ms >= 2.0 && st.max_render_ms >= st.avg_render_ms, "on time: render times");
+    }
+
+    // Depth 1, 60 ms frames. Frame 3 starts rendering once frame 2 is taken (~60 ms)
+    // and takes 150 ms: ready at ~210 for a 180 deadline, before frame 4 is due at 240.
+    // Shown 30 ms late, which is a miss, not a drop.
+    {
+        FrameScheduler sched(1, milliseconds(5));
+        FakeRenderer render;
+        render.delay = { milliseconds(0), milliseconds(0), milliseconds(0), milliseconds(150) };
+        Publisher publish;
+        const auto st = run(sched, 6, milliseconds(60), render, publish);
+        check(st.published == 6 && st.dropped == 0, "late frame: all shown");
+        check(st.missed == 1, "late frame: one miss, got " + std::to_string(st.missed));
+        check(st.max_late_ms >= 20.0 && st.max_render_ms >= 150.0, "late frame: lateness and render time");
+        check(!publish.early && !publish.mismatched, "late frame: deadlines and payloads");
+    }
+
+    // Depth 1, 40 ms frames. Frame 3 renders from ~40 to ~260: stale (frame 4 was due
+    // at 160) so it is dropped, and the renderer jumps to frame 6 (due 240, next 280),
+    // skipping 4 and 5.
+    {
+        FrameScheduler sched(1, milliseconds(100));
+        FakeRenderer render;
+        render.delay = { milliseconds(0), milliseconds(0), milliseconds(0), milliseconds(220) };
+        Publisher publish;
+        const auto st = run(sched, 10, milliseconds(40), render, publish);
+        check(indices(publish.shown) == "0,1,2,6,7,8,9", "slow frame: shown " + indices(publish.shown));
+        check(st.rendered == 8 && render.calls == 8, "slow frame: 4 and 5 never rendered");
+        check(st.published == 7 && st.dropped == 3 && st.missed == 0,
+              "slow frame: published/dropped/missed " + std::to_string(st.published) + "/" +
+              std::to_string(st.dropped) + "/" + std::to_string(st.missed));
+        check(!publish.early && !publish.mismatched, "slow frame: deadlines and payloads");
+    }
+
+    // Render throws at frame 4: the frames already rendered are still shown, then the
+    // error comes out of run() with the worker joined
+    {
+        FrameScheduler sched(2, milliseconds(100));
+        FakeRenderer render;
+        render.throw_at = 4;
+        Publisher publish;
+        std::string what;
+        try {
+            run(sched, 10, milliseconds(20), render, publish);
+        } catch (const std::runtime_error& e) {
+            what = e.what();
+        }
+        check(what == "render failed at 4", "render throws: rethrown, got \"" + what + "\"");
+        check(indices(publish.shown) == "0,1,2,3", "render throws: shown " + indices(publish.shown));
+        const int calls = render.calls;
+        std::this_thread::sleep_for(milliseconds(50));
+        check(calls == 5 && render.calls == calls, "render throws: no renders after the failure");
+    }
+
+    // Depth 1, 30 ms frames. Publish throws at frame 2 (due 60) while frame 3 renders
+    // from ~30 to ~110: run() must wait for that render and the worker to exit before
+    // it rethrows
+    {
+        FrameScheduler sched(1, milliseconds(100));
+        FakeRenderer render;
+        render.delay = { milliseconds(5), milliseconds(5), milliseconds(5), milliseconds(80) };
+        Publisher publish;
+        publish.throw_at = 2;
+        std::string what;
+        try {
+            run(sched, 10, milliseconds(30), render, publish);
+        } catch (const std::runtime_error& e) {
+            what = e.what();
+        }
+        check(what == "publish failed at 2", "publish throws: rethrown, got \"" + what + "\"");
+        check(!render.in_render, "publish throws: no render still running");
+        const int calls = render.calls;
+        std::this_thread::sleep_for(milliseconds(100));
+        check(render.calls == calls && calls == 4, "publish throws: worker stopped after frame 3");
+        check(indices(publish.shown) == "0,1", "publish throws: shown " + indices(publish.shown));
+
+        // The same scheduler runs again cleanly afterwards
+        FakeRenderer again;
+        Publisher publish2;
+        const auto st = run(sched, 3, milliseconds(20), again, publish2);
+        check(st.published == 3 && indices(publish2.shown) == "0,1,2", "rerun after a failure");
+    }
+
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("frame_scheduler: counts, ordering and exceptions as expected\n");
+    return 0;
+}
@@ -0,0 +1,287 @@
+#include "frame_server.hpp"
+#include "trace.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+static const char* kFramePath = "/frame.png";
+static const char* kBoundary  = "overlayframe";
+
+// A client that sends no request, or stops reading a stream, is dropped after this
+static const int kClientTimeoutSec = 10;
+
+// ---------- small helpers ----------
+static std::string make_etag(const std::string& body) {
+    uint64_t h = 1469598103934665603ull;  // FNV-1a
+    for (unsigned char c : body) { h ^= c; h *= 1099511628211ull; }
+    char buf[24];
+    std::snprintf(buf, sizeof(buf), "\"%016llx\"", (unsigned long long)h);
+    return buf;
+}
+
+static bool send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n; len -= (size_t)n;
+    }
+    return true;
+}
+static bool send_all(int fd, const std::string& s) { return send_all(fd, s.data(), s.size()); }
+
+static std::string status_line(int code) {
+    switch (code) {
+        case 200: return "HTTP/1.1 200 OK\r\n";
+        case 304: return "HTTP/1.1 304 Not Modified\r\n";
+        case 404: return "HTTP/1.1 404 Not Found\r\n";
+        case 405: return "HTTP/1.1 405 Method Not Allowed\r\n";
+        default:  return "HTTP/1.1 400 Bad Request\r\n";
+    }
+}
+
+static void send_simple(int fd, int code) {
+    std::string r = status_line(code) + "Content-Length: 0\r\nConnection: close\r\n\r\n";
+    send_all(fd, r);
+}
+
+// Request line + headers (lower-cased names). Body is never needed for GET/HEAD.
+struct HttpRequest {
+    std::string method, path;
+    std::map<std::string, std::string> headers;
+};
+
+static bool read_request(int fd, HttpRequest& req) {
+    std::string buf;
+    char chunk[1024];
+    while (buf.find("\r\n\r\n") == std::string::npos) {
+        if (buf.size() > 16 * 1024) return false;
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buf.append(chunk, (size_t)n);
+    }
+
+    std::istringstream in(buf.substr(0, buf.find("\r\n\r\n")));
+    std::string line, version;
+    if (!std::getline(in, line)) return false;
+    std::istringstream rl(line);
+    if (!(rl >> req.method >> req.path >> version)) return false;
+    req.path = req.path.substr(0, req.path.find('?'));
+
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        size_t v = line.find_first_not_of(' ', colon + 1);
+        req.headers[name] = v == std::string::npos ? "" : line.substr(v);
+    }
+    return true;
+}
+
+// ---------- FrameServer ----------
+FrameServer::~FrameServer() { stop(); }
+
+bool FrameServer::start(int port, const std::string& bind_addr) {
+    if (listen_fd_ >= 0) return false;
+
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) { std::perror("socket"); return false; }
+    int yes = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (::inet_pton(AF_INET, bind_addr.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "Bad bind address " << bind_addr << "\n";
+        ::close(listen_fd_); listen_fd_ = -1;
+        return false;
+    }
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listen_fd_, 16) < 0) {
+        std::perror("bind/listen");
+        ::close(listen_fd_); listen_fd_ = -1;
+        return false;
+    }
+
+    running_ = true;
+    accept_thread_ = std::thread(&FrameServer::acceptLoop, this);
+    return true;
+}
+
+void FrameServer::stop() {
+    if (!running_.exchange(false)) return;
+    // Wakes accept(); the fd itself is only closed once the acceptor has exited
+    ::shutdown(listen_fd_, SHUT_RDWR);
+    frame_cv_.notify_all();
+    if (accept_thread_.joinable()) accept_thread_.join();
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+
+    // Unblock clients stuck in recv/send (idle preconnects, stalled streams);
+    // streaming clients also notice running_ on their next wake-up
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (int fd : client_fds_) ::shutdown(fd, SHUT_RDWR);
+    }
+    while (active_clients_ > 0) {
+        frame_cv_.notify_all();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void FrameServer::publish(const std::string& path, const std::string& content_type, std::string body) {
+    Resource r;
+    r.content_type = content_type;
+    r.etag = make_etag(body);
+    r.body = std::move(body);
+    std::lock_guard<std::mutex> lock(mutex_);
+    resources_[path] = std::move(r);
+}
+
+void FrameServer::publishFrame(std::string png_bytes) {
+    const std::string etag = make_etag(png_bytes);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = resources_.find(kFramePath);
+        if (it != resources_.end() && it->second.etag == etag) return;  // identical frame
+        Resource& r = resources_[kFramePath];
+        r.content_type = "image/png";
+        r.body = std::move(png_bytes);
+        r.etag = etag;
+        ++frame_version_;
+    }
+    frame_cv_.notify_all();
+}
+
+void FrameServer::acceptLoop() {
+    while (running_) {
+        int fd = ::accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            if (!running_) break;
+            continue;
+        }
+        timeval tv{ kClientTimeoutSec, 0 };
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex_);
+            if (!running_) { ::close(fd); break; }
+            client_fds_.insert(fd);
+        }
+        ++active_clients_;
+        std::thread([this, fd]() {
+            handleClient(fd);
+            {
+                // Unregister before closing so stop() never shuts down a reused fd
+                std::lock_guard<std::mutex> lock(clients_mutex_);
+                client_fds_.erase(fd);
+                ::close(fd);
+            }
+            --active_clients_;
+        }).detach();
+    }
+}
+
+void FrameServer::handleClient(int fd) {
+    HttpRequest req;
+    if (!read_request(fd, req)) { send_simple(fd, 400); return; }
+    if (req.method != "GET" && req.method != "HEAD") { send_simple(fd, 405); return; }
+
+    if (req.path == "/events") { serveEvents(fd); return; }
+    if (req.path == "/stream") { serveStream(fd); return; }
+
+    Resource r;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = resources_.find(req.path);
+        if (it == resources_.end()) { send_simple(fd, 404); return; }
+        r = it->second;
+    }
+
+    // Browser sources revalidate every fetch; unchanged frames cost a 304 and no body
+    std::string head = "ETag: " + r.etag + "\r\nCache-Control: no-cache\r\n"
+                       "Access-Control-Allow-Origin: *\r\nConnection: close\r\n";
+    auto inm = req.headers.find("if-none-match");
+    if (inm != req.headers.end() && inm->second.find(r.etag) != std::string::npos) {
+        send_all(fd, status_line(304) + head + "\r\n");
+        return;
+    }
+
+    head = status_line(200) + head + "Content-Type: " + r.content_type + "\r\n" +
+           "Content-Length: " + std::to_string(r.body.size()) + "\r\n\r\n";
+    if (!send_all(fd, head)) return;
+    if (req.method == "GET") send_all(fd, r.body);
+}
+
+void FrameServer::serveEvents(int fd) {
+    const std::string head = status_line(200) +
+        "Content-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+        "Access-Control-Allow-Origin: *\r\nConnection: keep-alive\r\n\r\n";
+    if (!send_all(fd, head)) return;
+
+    uint64_t seen = 0;
+    while (running_) {
+        std::string msg;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            frame_cv_.wait_for(lock, std::chrono::seconds(15),
+                               [&] { return !running_ || frame_version_ != seen; });
+            if (!running_) break;
+            if (frame_version_ != seen) {
+                seen = frame_version_;
+                msg = "event: frame\ndata: " + resources_[kFramePath].etag + "\n\n";
+            } else {
+                msg = ": keep-alive\n\n";  // lets us notice closed connections
+            }
+        }
+        if (!send_all(fd, msg)) break;
+    }
+}
+
+void FrameServer::serveStream(int fd) {
+    const std::string head = status_line(200) +
+        "Content-Type: multipart/x-mixed-replace; boundary=" + kBoundary + "\r\n"
+        "Cache-Control: no-cache\r\nConnection: close\r\n\r\n";
+    if (!send_all(fd, head)) return;
+
+    uint64_t seen = 0;
+    while (running_) {
+        Resource frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            frame_cv_.wait(lock, [&] { return !running_ || (frame_version_ != seen && frame_version_ != 0); });
+            if (!running_) break;
+            seen = frame_version_;
+            frame = resources_[kFramePath];
+        }
+        std::string part = std::string("--") + kBoundary + "\r\nContent-Type: image/png\r\n"
+                           "Content-Length: " + std::to_string(frame.body.size()) + "\r\n\r\n";
+        if (!send_all(fd, part) || !send_all(fd, frame.body) || !send_all(fd, "\r\n")) break;
+    }
+}
+
+// ---------- PNG to memory ----------
+static cairo_status_t append_png_bytes(void* closure, const unsigned char* data, unsigned int length) {
+    static_cast<std::string*>(closure)->append(reinterpret_cast<const char*>(data), length);
+    return CAIRO_STATUS_SUCCESS;
+}
+
+std::string surfaceToPngBytes(cairo_surface_t* surface) {
+    TRACE_SCOPE("png.encode");
+    TRACE_BYTES((uint64_t)cairo_image_surface_get_stride(surface) * cairo_image_surface_get_height(surface));
+    std::string out;
+    if (cairo_surface_write_to_png_stream(surface, append_png_bytes, &out) != CAIRO_STATUS_SUCCESS)
+        out.clear();
+    return out;
+}
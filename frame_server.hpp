@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <map>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <cairo.h>
+
+// Small embedded HTTP/1.1 server for OBS/browser-source overlays.
+//   GET <path>      any published resource, with ETag / If-None-Match -> 304
+//   GET /events     server-sent events, one "frame" event per new /frame.png
+//   GET /stream     multipart/x-mixed-replace stream of PNG frames (MJPEG-style)
+// Binds to localhost by default; one thread per connection.
+class FrameServer {
+public:
+    FrameServer() = default;
+    ~FrameServer();
+    FrameServer(const FrameServer&) = delete;
+    FrameServer& operator=(const FrameServer&) = delete;
+
+    // False if the socket cannot be bound or the server is already started
+    bool start(int port, const std::string& bind_addr = "127.0.0.1");
+    void stop();
+
+    // Add or replace a static resource (e.g. "/", "/sprites.png")
+    void publish(const std::string& path, const std::string& content_type, std::string body);
+
+    // Replace /frame.png and wake /events and /stream clients (skipped if unchanged)
+    void publishFrame(std::string png_bytes);
+
+private:
+    struct Resource {
+        std::string content_type;
+        std::string body;
+        std::string etag;
+    };
+
+    void acceptLoop();
+    void handleClient(int fd);
+    void serveEvents(int fd);
+    void serveStream(int fd);
+
+    // Written only by start() and by stop() after the accept thread has joined
+    int listen_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread accept_thread_;
+    std::atomic<int> active_clients_{0};
+
+    // Open client sockets, so stop() can shut them down and unblock recv/send
+    std::mutex clients_mutex_;
+    std::set<int> client_fds_;
+
+    std::mutex mutex_;
+    std::condition_variable frame_cv_;
+    std::map<std::string, Resource> resources_;
+    uint64_t frame_version_ = 0;
+};
+
+// Encode a surface as PNG into memory
+std::string surfaceToPngBytes(cairo_surface_t* surface);
@@ -0,0 +1,300 @@
+#include "image_resample.hpp"
+#include "surface_pool.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RESAMPLE_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+// Pixels per pass below which threads cost more than they save
+static const size_t kMinPixelsPerThread = 64 * 1024;
+
+// ---- Kernels ----
+static double kernel_support(ResampleFilter f) {
+    switch (f) {
+        case ResampleFilter::Box:      return 0.5;
+        case ResampleFilter::Bilinear: return 1.0;
+        default:                       return 3.0;
+    }
+}
+
+static double sinc(double x) {
+    if (x == 0.0) return 1.0;
+    x *= M_PI;
+    return std::sin(x) / x;
+}
+
+static double kernel_eval(ResampleFilter f, double x) {
+    x = std::fabs(x);
+    switch (f) {
+        case ResampleFilter::Box:      return x <= 0.5 ? 1.0 : 0.0;
+        case ResampleFilter::Bilinear: return x < 1.0 ? 1.0 - x : 0.0;
+        default:                       return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+}
+
+// For each output index: first source index and `taps` normalized weights.
+// Every window has the same width; taps that fall off the edge fold onto the edge pixel.
+struct Taps {
+    int taps = 0;
+    std::vector<int> start;
+    std::vector<float> weights;  // out_n * taps
+};
+
+static Taps make_taps(int src_n, int dst_n, ResampleFilter f) {
+    const double scale = (double)src_n / dst_n;
+    const double fscale = std::max(1.0, scale);
+    const double support = kernel_support(f) * fscale;
+    const int raw_taps = (int)std::ceil(support * 2.0) + 1;
+
+    Taps t;
+    t.taps = std::min(src_n, raw_taps);
+    t.start.resize(dst_n);
+    t.weights.assign((size_t)dst_n * t.taps, 0.0f);
+
+    std::vector<double> w(t.taps);
+    for (int i = 0; i < dst_n; ++i) {
+        const double center = (i + 0.5) * scale;
+        const int first = (int)std::ceil(center - support - 0.5);
+        const int s = std::clamp(first, 0, src_n - t.taps);
+        std::fill(w.begin(), w.end(), 0.0);
+
+        double sum = 0.0;
+        for (int k = first; k < first + raw_taps; ++k) {
+            const double v = kernel_eval(f, (k + 0.5 - center) / fscale);
+            w[std::clamp(k, 0, src_n - 1) - s] += v;
+            sum += v;
+        }
+        if (sum == 0.0) {
+            w[std::clamp((int)center, 0, src_n - 1) - s] = 1.0;
+            sum = 1.0;
+        }
+        t.start[i] = s;
+        for (int k = 0; k < t.taps; ++k) t.weights[(size_t)i * t.taps + k] = (float)(w[k] / sum);
+    }
+    return t;
+}
+
+// ---- Horizontal pass: one ARGB32 row -> dst_w * 4 floats (lanes in byte order) ----
+static void hpass_row_scalar(const uint32_t* src, float* out, const Taps& t, int dst_w) {
+    for (int x = 0; x < dst_w; ++x) {
+        const uint32_t* p = src + t.start[x];
+        const float* w = &t.weights[(size_t)x * t.taps];
+        float c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+        for (int k = 0; k < t.taps; ++k) {
+            const uint32_t v = p[k];
+            c0 += w[k] * (float)(v & 0xff);
+            c1 += w[k] * (float)((v >> 8) & 0xff);
+            c2 += w[k] * (float)((v >> 16) & 0xff);
+            c3 += w[k] * (float)(v >> 24);
+        }
+        out[x * 4 + 0] = c0; out[x * 4 + 1] = c1; out[x * 4 + 2] = c2; out[x * 4 + 3] = c3;
+    }
+}
+
+// ---- Vertical pass: taps float rows -> one ARGB32 row ----
+static inline uint32_t pack_pixel(const float* c) {
+    // Premultiplied: colour may not exceed alpha (Lanczos overshoot would break that)
+    const float a = std::clamp(std::nearbyint(c[3]), 0.0f, 255.0f);
+    const uint32_t c0 = (uint32_t)std::clamp(std::nearbyint(c[0]), 0.0f, a);
+    const uint32_t c1 = (uint32_t)std::clamp(std::nearbyint(c[1]), 0.0f, a);
+    const uint32_t c2 = (uint32_t)std::clamp(std::nearbyint(c[2]), 0.0f, a);
+    return c0 | (c1 << 8) | (c2 << 16) | ((uint32_t)a << 24);
+}
+
+static void vpass_row_scalar(const float* rows, size_t row_len, const float* w, int taps,
+                             float* acc, uint32_t* dst, int dst_w) {
+    std::fill(acc, acc + row_len, 0.0f);
+    for (int k = 0; k < taps; ++k) {
+        const float* r = rows + (size_t)k * row_len;
+        const float wk = w[k];
+        for (size_t i = 0; i < row_len; ++i) acc[i] += wk * r[i];
+    }
+    for (int x = 0; x < dst_w; ++x) dst[x] = pack_pixel(acc + x * 4);
+}
+
+#ifdef RESAMPLE_HAVE_AVX2
+// Two taps per step: 8 bytes (2 pixels) widened to 8 floats against [w0 x4, w1 x4]
+__attribute__((target("avx2,fma")))
+static void hpass_row_avx2(const uint32_t* src, float* out, const Taps& t, int dst_w) {
+    for (int x = 0; x < dst_w; ++x) {
+        const uint32_t* p = src + t.start[x];
+        const float* w = &t.weights[(size_t)x * t.taps];
+        __m256 acc = _mm256_setzero_ps();
+        int k = 0;
+        for (; k + 1 < t.taps; k += 2) {
+            const __m128i px = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + k));
+            const __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(px));
+            const __m256 wv = _mm256_set_m128(_mm_set1_ps(w[k + 1]), _mm_set1_ps(w[k]));
+            acc = _mm256_fmadd_ps(v, wv, acc);
+        }
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        if (k < t.taps) {
+            const __m128i px = _mm_cvtsi32_si128((int)p[k]);
+            sum = _mm_fmadd_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(px)), _mm_set1_ps(w[k]), sum);
+        }
+        _mm_storeu_ps(out + x * 4, sum);
+    }
+}
+
+// 8 floats (2 pixels) at a time; alpha is lane 3 of each 128-bit half
+__attribute__((target("avx2,fma")))
+static void vpass_row_avx2(const float* rows, size_t row_len, const float* w, int taps,
+                           float* acc, uint32_t* dst, int dst_w) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 max8 = _mm256_set1_ps(255.0f);
+    size_t i = 0;
+    for (; i + 8 <= row_len; i += 8) {
+        __m256 s = _mm256_setzero_ps();
+        for (int k = 0; k < taps; ++k)
+            s = _mm256_fmadd_ps(_mm256_loadu_ps(rows + (size_t)k * row_len + i), _mm256_set1_ps(w[k]), s);
+        s = _mm256_round_ps(s, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        const __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_permute_ps(s, 0xFF), zero), max8);
+        s = _mm256_min_ps(_mm256_max_ps(s, zero), a);
+        const __m256i q = _mm256_cvtps_epi32(s);
+        const __m128i w16 = _mm_packus_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i / 4), _mm_packus_epi16(w16, w16));
+    }
+    if (i < row_len) {
+        // Odd width: last pixel
+        std::fill(acc, acc + 4, 0.0f);
+        for (int k = 0; k < taps; ++k)
+            for (int c = 0; c < 4; ++c) acc[c] += w[k] * rows[(size_t)k * row_len + i + c];
+        dst[dst_w - 1] = pack_pixel(acc);
+    }
+}
+
+static bool cpu_has_avx2() {
+    static const bool v = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return v;
+}
+#endif
+
+// ---- Row threading ----
+template <class Fn>
+static void parallel_rows(int rows, size_t pixels, unsigned threads, Fn fn) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = (unsigned)std::min<size_t>(threads, std::max<size_t>(1, pixels / kMinPixelsPerThread));
+    threads = std::min<unsigned>(threads, (unsigned)std::max(1, rows));
+    if (threads <= 1) { fn(0, rows); return; }
+
+    const int chunk = 16;
+    std::atomic<int> next{0};
+    auto worker = [&]() {
+        for (int y = next.fetch_add(chunk); y < rows; y = next.fetch_add(chunk))
+            fn(y, std::min(rows, y + chunk));
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+}
+
+// RGB24 (opaque PNGs) has an undefined top byte; paint it into ARGB32 first
+static cairo_surface_t* as_argb32(cairo_surface_t* src) {
+    if (cairo_image_surface_get_format(src) == CAIRO_FORMAT_ARGB32) return cairo_surface_reference(src);
+    const int w = cairo_image_surface_get_width(src), h = cairo_image_surface_get_height(src);
+    cairo_surface_t* out = surface_pool_acquire(w, h, false);
+    cairo_t* cr = cairo_create(out);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr, src, 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    return out;
+}
+
+cairo_surface_t* resample_surface(cairo_surface_t* src_in, int width, int height,
+                                  ResampleFilter filter, unsigned threads) {
+    if (!src_in || width <= 0 || height <= 0 ||
+        cairo_surface_status(src_in) != CAIRO_STATUS_SUCCESS) return nullptr;
+    const int sw = cairo_image_surface_get_width(src_in);
+    const int sh = cairo_image_surface_get_height(src_in);
+    if (sw <= 0 || sh <= 0) return nullptr;
+
+    TRACE_SCOPE("resample");
+    TRACE_BYTES((uint64_t)width * height * 4);
+
+    cairo_surface_t* src = as_argb32(src_in);
+    cairo_surface_flush(src);
+    const unsigned char* sdata = cairo_image_surface_get_data(src);
+    const int sstride = cairo_image_surface_get_stride(src);
+
+    const Taps tx = make_taps(sw, width, filter);
+    const Taps ty = make_taps(sh, height, filter);
+
+#ifdef RESAMPLE_HAVE_AVX2
+    const bool avx2 = cpu_has_avx2();
+    auto hpass = avx2 ? hpass_row_avx2 : hpass_row_scalar;
+    auto vpass = avx2 ? vpass_row_avx2 : vpass_row_scalar;
+#else
+    auto hpass = hpass_row_scalar;
+    auto vpass = vpass_row_scalar;
+#endif
+
+    // Horizontal: every source row to width*4 floats
+    const size_t row_len = (size_t)width * 4;
+    std::vector<float> tmp(row_len * sh);
+    parallel_rows(sh, (size_t)width * sh, threads, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y)
+            hpass(reinterpret_cast<const uint32_t*>(sdata + (size_t)y * sstride), &tmp[row_len * y], tx, width);
+    });
+
+    // Vertical: each output row from ty.taps consecutive float rows
+    cairo_surface_t* out = surface_pool_acquire(width, height, false);
+    unsigned char* ddata = cairo_image_surface_get_data(out);
+    const int dstride = cairo_image_surface_get_stride(out);
+    parallel_rows(height, (size_t)width * height, threads, [&](int y0, int y1) {
+        std::vector<float> acc(row_len);
+        for (int y = y0; y < y1; ++y)
+            vpass(&tmp[row_len * ty.start[y]], row_len, &ty.weights[(size_t)y * ty.taps], ty.taps,
+                  acc.data(), reinterpret_cast<uint32_t*>(ddata + (size_t)y * dstride), width);
+    });
+    cairo_surface_mark_dirty(out);
+    cairo_surface_destroy(src);
+    return out;
+}
+
+// ---- Mipmaps ----
+Mipmap mipmap_build(cairo_surface_t* src) {
+    Mipmap mip;
+    if (!src) return mip;
+    mip.levels.push_back(cairo_surface_reference(src));
+    int w = cairo_image_surface_get_width(src), h = cairo_image_surface_get_height(src);
+    while (w > 1 || h > 1) {
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+        cairo_surface_t* next = resample_surface(mip.levels.back(), w, h, ResampleFilter::Box);
+        if (!next) break;
+        mip.levels.push_back(next);
+    }
+    return mip;
+}
+
+cairo_surface_t* mipmap_level_for(const Mipmap& mip, int width, int height) {
+    if (mip.levels.empty()) return nullptr;
+    cairo_surface_t* best = mip.levels.front();
+    for (cairo_surface_t* s : mip.levels) {
+        if (cairo_image_surface_get_width(s) < width || cairo_image_surface_get_height(s) < height) break;
+        best = s;
+    }
+    return cairo_surface_reference(best);
+}
+
+cairo_surface_t* mipmap_resample(const Mipmap& mip, int width, int height, ResampleFilter filter) {
+    cairo_surface_t* level = mipmap_level_for(mip, width, height);
+    if (!level) return nullptr;
+    cairo_surface_t* out = resample_surface(level, width, height, filter);
+    cairo_surface_destroy(level);
+    return out;
+}
+
+void mipmap_free(Mipmap& mip) {
+    for (cairo_surface_t* s : mip.levels) cairo_surface_destroy(s);
+    mip.levels.clear();
+}
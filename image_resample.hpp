@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <cairo.h>
+
+// Separable resampling of premultiplied ARGB32 surfaces. Two passes (horizontal,
+// then vertical) through float rows, AVX2+FMA when the CPU has it and a scalar
+// path otherwise, with rows split across threads. Downscaling widens the kernel
+// by the scale factor, so there is no aliasing.
+
+enum class ResampleFilter {
+    Box,       // area average; best for exact 1/2, 1/3, ... reductions
+    Bilinear,  // triangle kernel
+    Lanczos3,  // sharpest; output is clamped so colour never exceeds alpha
+};
+
+// New ARGB32 surface of width x height (caller destroys), or nullptr on bad input.
+// threads == 0 picks hardware_concurrency (small images stay single-threaded).
+cairo_surface_t* resample_surface(cairo_surface_t* src, int width, int height,
+                                  ResampleFilter filter = ResampleFilter::Lanczos3,
+                                  unsigned threads = 0);
+
+// Chain of successively halved copies (level 0 is the source itself, last is 1x1)
+// for assets drawn at many sizes: resample from the nearest level that is still
+// at least as large as the target instead of from full resolution every time.
+struct Mipmap {
+    std::vector<cairo_surface_t*> levels;
+};
+
+Mipmap mipmap_build(cairo_surface_t* src);
+
+// Smallest level at least width x height (new reference; caller destroys).
+cairo_surface_t* mipmap_level_for(const Mipmap& mip, int width, int height);
+
+// resample_surface() starting from mipmap_level_for().
+cairo_surface_t* mipmap_resample(const Mipmap& mip, int width, int height,
+                                 ResampleFilter filter = ResampleFilter::Lanczos3);
+
+void mipmap_free(Mipmap& mip);
@@ -1,6 +1,10 @@
-#include "file_type_check.hpp"
+#include "import_check.hpp"
+#include "asset_prewarm.hpp"
+#include "layer_cache.hpp"
+#include "image_resample.hpp"
 #include <librsvg/rsvg.h>
 #include <glib.h>
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
@@ -24,6 +28,19 @@ static cairo_surface_t* load_png(const std::string& path){
         cairo_surface_destroy(s);
         return nullptr;
     }
+    // Opaque PNGs decode as RGB24, which the layer cache rejects; painting into
+    // ARGB32 sets alpha to 0xff and leaves the colours alone
+    if (cairo_image_surface_get_format(s) != CAIRO_FORMAT_ARGB32){
+        cairo_surface_t* argb = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+            cairo_image_surface_get_width(s), cairo_image_surface_get_height(s));
+        cairo_t* cr = cairo_create(argb);
+        cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(cr, s, 0, 0);
+        cairo_paint(cr);
+        cairo_destroy(cr);
+        cairo_surface_destroy(s);
+        s = argb;
+    }
     return s;
 }
 
@@ -60,29 +77,73 @@ static cairo_surface_t* render_svg(const std::string& path, int w, int h){
     return surf;
 }
 
+// PNG at its native size through the cache, resampled to w x h
+static cairo_surface_t* resample_png(const std::string& path, int w, int h){
+    cairo_surface_t* full = layer_cache_get({ path, "png", 0, 0 }, [path](int, int){ return load_png(path); });
+    if (!full) return nullptr;
+    cairo_surface_t* scaled = resample_surface(full, w, h, ResampleFilter::Lanczos3);
+    cairo_surface_destroy(full);
+    return scaled;
+}
+
+// Private copy of a cached layer (callers are free to modify the pixels)
+static cairo_surface_t* copy_of(cairo_surface_t* cached){
+    if (!cached) return nullptr;
+    cairo_surface_t* copy = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+        cairo_image_surface_get_width(cached), cairo_image_surface_get_height(cached));
+    cairo_t* cr = cairo_create(copy);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr, cached, 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    cairo_surface_destroy(cached);
+    return copy;
+}
+
+// Everything goes through the layer cache (PNGs and unsized SVGs at their intrinsic
+// 0x0 key), so a long-running process reads each asset once and an AssetWatcher
+// refreshes just the ones that change on disk.
 cairo_surface_t* load_image_or_svg(const std::string& path, int width, int height){
     if (ends_with_ci(path, ".png")){
-        return load_png(path);
+        LayerKey native { path, "png", 0, 0 };
+        if (width <= 0 && height <= 0)
+            return copy_of(layer_cache_get(native, [path](int, int){ return load_png(path); }));
+
+        // Sized PNGs are resampled once (Lanczos, premultiplied) and cached at that
+        // size, instead of being scaled by a cairo pattern filter on every paint.
+        // A missing dimension follows the aspect ratio.
+        cairo_surface_t* src = layer_cache_get(native, [path](int, int){ return load_png(path); });
+        if (!src) return nullptr;
+        const int sw = cairo_image_surface_get_width(src), sh = cairo_image_surface_get_height(src);
+        cairo_surface_destroy(src);
+        if (width <= 0)  width  = std::max(1, (int)((long long)sw * height / sh));
+        if (height <= 0) height = std::max(1, (int)((long long)sh * width / sw));
+        if (width == sw && height == sh)
+            return copy_of(layer_cache_get(native, [path](int, int){ return load_png(path); }));
+
+        return copy_of(layer_cache_get({ path, "png", width, height },
+            [path](int w, int h){ return resample_png(path, w, h); }));
     } else if (ends_with_ci(path, ".svg")){
-        return render_svg(path, width, height);
+        // A missing side is keyed as 0 and filled in from the SVG by render_svg
+        return copy_of(layer_cache_get({ path, "", std::max(width, 0), std::max(height, 0) },
+            [path](int w, int h){ return render_svg(path, w, h); }));
     } else {
         std::cerr << "Unsupported file type: " << path << "\n";
         return nullptr;
     }
 }
 
-
-
-// ---------- small helpers ----------
-static bool ends_with(const std::string& s, const char* suf){
-    size_t n = std::strlen(suf);
-    return s.size() >= n && strncasecmp(s.c_str()+s.size()-n, suf, n) == 0;
-}
-
-static bool atomic_write_png(cairo_surface_t* surf, const std::string& outpath){
-    std::string tmp = outpath + ".tmp";
-    if (cairo_surface_write_to_png(surf, tmp.c_str()) != CAIRO_STATUS_SUCCESS) return false;
-    std::remove(outpath.c_str()); // OK if it doesn't exist
-    return std::rename(tmp.c_str(), outpath.c_str()) == 0;
+// Same keys and renderers as load_image_or_svg() above
+size_t prewarm_images(const std::vector<std::string>& dirs,
+                      const std::vector<std::pair<int, int>>& sizes,
+                      const std::string& atlas_path){
+    std::vector<PrewarmSet> sets;
+    for (const std::string& dir : dirs){
+        sets.push_back({ dir, sizes, ".svg", "",
+                         [](const std::string& p, int w, int h){ return render_svg(p, w, h); } });
+        sets.push_back({ dir, sizes, ".png", "png",
+                         [](const std::string& p, int w, int h){ return resample_png(p, w, h); } });
+    }
+    return prewarm_with_atlas(atlas_path, sets);
 }
 
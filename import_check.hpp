@@ -1,8 +1,18 @@
 #pragma once
 #include <string>
+#include <utility>
+#include <vector>
 #include <cairo/cairo.h>
 
 // Detect file extension and load into a Cairo surface.
 // Returns nullptr if unsupported or load fails.
-// If SVG and width/height > 0, resizes output.
+// If SVG and width/height > 0, resizes output. PNGs are resampled to the requested
+// size (one dimension <= 0 keeps the aspect ratio).
 cairo_surface_t* load_image_or_svg(const std::string& path, int width = -1, int height = -1);
+
+// Warm the cache load_image_or_svg() reads from: every .svg and .png in `dirs` at
+// each of `sizes`, on all cores. With an atlas path the layers are loaded from (and
+// saved back to) that file, see prewarm_with_atlas(). Returns the layers cached.
+size_t prewarm_images(const std::vector<std::string>& dirs,
+                      const std::vector<std::pair<int, int>>& sizes,
+                      const std::string& atlas_path = "");
@@ -0,0 +1,344 @@
+#include "layer_cache.hpp"
+#include <cairo.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct LayerEntry {
+    cairo_surface_t* surface = nullptr;
+    LayerKey key;
+    LayerRenderFn render;   // empty for layer_cache_put() entries
+    std::string blob;       // disk blob written for this entry, if any
+    int64_t asset_mtime = kLayerMtimeUnknown;   // asset as it was when rendered
+    size_t bytes = 0;
+    std::list<std::string>::iterator lru{};
+};
+
+static std::mutex g_mutex;
+static std::unordered_map<std::string, LayerEntry> g_layers;
+static std::list<std::string> g_lru;   // most recently used first
+static size_t g_bytes = 0;
+static size_t g_max_bytes = 0;
+static bool g_max_bytes_init = false;
+static std::string g_disk_dir;
+static bool g_disk_dir_init = false;
+
+static const size_t kDefaultMaxMB = 256;
+
+static const char kBlobMagic[4] = { 'L', 'Y', 'R', '1' };
+
+// "asset|color|WxH" - also the input to the disk blob name
+static std::string key_string(const LayerKey& k) {
+    std::ostringstream oss;
+    oss << k.asset << '|' << k.color_key << '|' << k.width << 'x' << k.height;
+    return oss.str();
+}
+
+// FNV-1a, good enough to name blob files
+static uint64_t fnv1a(const std::string& s) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : s) { h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+int64_t layer_asset_mtime(const std::string& path) {
+    std::error_code ec;
+    auto t = fs::last_write_time(path, ec);
+    return ec ? 0 : (int64_t)t.time_since_epoch().count();
+}
+
+// Blob name covers the asset's mtime so an edited SVG never hits a stale blob
+static std::string blob_path(const std::string& dir, const LayerKey& k, int64_t mtime) {
+    std::string id = key_string(k);
+    if (mtime != 0) id += '|' + std::to_string(mtime);
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.argb", (unsigned long long)fnv1a(id));
+    return (fs::path(dir) / name).string();
+}
+
+static cairo_surface_t* read_blob(const std::string& path, int w, int h) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return nullptr;
+
+    char magic[4];
+    uint32_t hdr[3];
+    if (!in.read(magic, 4) || std::memcmp(magic, kBlobMagic, 4) != 0) return nullptr;
+    if (!in.read(reinterpret_cast<char*>(hdr), sizeof(hdr))) return nullptr;
+    if ((int)hdr[0] != w || (int)hdr[1] != h) return nullptr;
+
+    cairo_surface_t* s = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+    if (cairo_surface_status(s) != CAIRO_STATUS_SUCCESS) { cairo_surface_destroy(s); return nullptr; }
+
+    unsigned char* data = cairo_image_surface_get_data(s);
+    int stride = cairo_image_surface_get_stride(s);
+    const size_t row_bytes = (size_t)w * 4;
+    for (int y = 0; y < h; ++y) {
+        if (!in.read(reinterpret_cast<char*>(data + (size_t)y * stride), row_bytes)) {
+            cairo_surface_destroy(s);
+            return nullptr;
+        }
+    }
+    cairo_surface_mark_dirty(s);
+    return s;
+}
+
+// Temp name unique to this process and call, so two writers of the same blob
+// never share a temp file
+static std::string temp_name(const std::string& path) {
+    static const uint64_t process_token = ((uint64_t)std::random_device{}() << 32) ^ std::random_device{}();
+    static std::atomic<uint64_t> counter{0};
+    char suffix[48];
+    std::snprintf(suffix, sizeof(suffix), ".%016llx.%llu.tmp",
+                  (unsigned long long)process_token, (unsigned long long)counter++);
+    return path + suffix;
+}
+
+// Written to a temp file and renamed, so concurrent processes never see half a blob
+static void write_blob(const std::string& path, cairo_surface_t* s) {
+    cairo_surface_flush(s);
+    const int w = cairo_image_surface_get_width(s);
+    const int h = cairo_image_surface_get_height(s);
+    const int stride = cairo_image_surface_get_stride(s);
+    const unsigned char* data = cairo_image_surface_get_data(s);
+
+    const std::string tmp = temp_name(path);
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return;
+        uint32_t hdr[3] = { (uint32_t)w, (uint32_t)h, (uint32_t)w * 4 };
+        out.write(kBlobMagic, 4);
+        out.write(reinterpret_cast<const char*>(hdr), sizeof(hdr));
+        for (int y = 0; y < h; ++y)
+            out.write(reinterpret_cast<const char*>(data + (size_t)y * stride), (size_t)w * 4);
+        if (!out) { std::remove(tmp.c_str()); return; }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) std::remove(tmp.c_str());
+}
+
+static std::string disk_dir_locked() {
+    if (!g_disk_dir_init) {
+        if (const char* env = std::getenv("LAYER_CACHE_DIR")) g_disk_dir = env;
+        g_disk_dir_init = true;
+    }
+    return g_disk_dir;
+}
+
+// ---- Memory budget ----
+// Least recently used layers are dropped once the cache holds more than the
+// budget; surfaces already handed out stay valid and a later get() re-renders.
+
+static size_t max_bytes_locked() {
+    if (!g_max_bytes_init) {
+        size_t mb = kDefaultMaxMB;
+        if (const char* env = std::getenv("LAYER_CACHE_MAX_MB")) mb = std::strtoull(env, nullptr, 10);
+        g_max_bytes = mb * 1024 * 1024;
+        g_max_bytes_init = true;
+    }
+    return g_max_bytes;
+}
+
+static size_t surface_bytes(cairo_surface_t* s) {
+    return (size_t)cairo_image_surface_get_stride(s) * cairo_image_surface_get_height(s);
+}
+
+static void touch_locked(LayerEntry& e) {
+    g_lru.splice(g_lru.begin(), g_lru, e.lru);
+}
+
+static void erase_locked(std::unordered_map<std::string, LayerEntry>::iterator it) {
+    g_bytes -= it->second.bytes;
+    g_lru.erase(it->second.lru);
+    g_layers.erase(it);
+}
+
+// Keeps at least the newest entry even if it alone is over budget
+static void evict_locked() {
+    const size_t budget = max_bytes_locked();
+    while (g_bytes > budget && g_lru.size() > 1) {
+        auto it = g_layers.find(g_lru.back());
+        cairo_surface_destroy(it->second.surface);
+        erase_locked(it);
+    }
+}
+
+// Takes ownership of entry.surface; returns the entry for the key (existing or new)
+static LayerEntry& insert_locked(const std::string& id, LayerEntry entry, bool& inserted) {
+    auto ins = g_layers.emplace(id, std::move(entry));
+    inserted = ins.second;
+    LayerEntry& e = ins.first->second;
+    if (inserted) {
+        e.bytes = surface_bytes(e.surface);
+        g_lru.push_front(id);
+        e.lru = g_lru.begin();
+        g_bytes += e.bytes;
+        evict_locked();
+    } else {
+        touch_locked(e);
+    }
+    return e;
+}
+
+cairo_surface_t* layer_cache_get(const LayerKey& key, const LayerRenderFn& render) {
+    if (key.width < 0 || key.height < 0) return nullptr;
+    const bool intrinsic = key.width == 0 || key.height == 0;
+    const std::string id = key_string(key);
+
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        auto it = g_layers.find(id);
+        if (it != g_layers.end()) {
+            touch_locked(it->second);
+            return cairo_surface_reference(it->second.surface);
+        }
+        dir = disk_dir_locked();
+    }
+
+    // Miss: rasterize outside the lock so other layers are not held up. The mtime is
+    // read first, so an edit during the render leaves the layer stamped as stale.
+    const int64_t mtime = layer_asset_mtime(key.asset);
+    cairo_surface_t* s = nullptr;
+    std::string blob;
+    if (!dir.empty() && !intrinsic) {
+        blob = blob_path(dir, key, mtime);
+        s = read_blob(blob, key.width, key.height);
+    }
+    if (!s) {
+        s = render(key.width, key.height);
+        if (!s) return nullptr;
+        if (cairo_surface_status(s) != CAIRO_STATUS_SUCCESS ||
+            cairo_image_surface_get_format(s) != CAIRO_FORMAT_ARGB32) {
+            cairo_surface_destroy(s);
+            return nullptr;
+        }
+        if (!blob.empty()) {
+            std::error_code ec;
+            fs::create_directories(dir, ec);
+            write_blob(blob, s);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    bool inserted;
+    // Referenced before eviction can run, so the caller's copy survives even if
+    // the budget drops it straight away
+    cairo_surface_t* out = cairo_surface_reference(s);
+    LayerEntry& e = insert_locked(id, LayerEntry{ s, key, render, blob, mtime }, inserted);
+    if (!inserted) {
+        // Another thread rendered the same layer first; keep theirs
+        cairo_surface_destroy(s);
+        cairo_surface_destroy(out);
+        out = cairo_surface_reference(e.surface);
+    }
+    return out;
+}
+
+cairo_surface_t* layer_cache_find(const LayerKey& key, int64_t* asset_mtime) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto it = g_layers.find(key_string(key));
+    if (it == g_layers.end()) return nullptr;
+    touch_locked(it->second);
+    if (asset_mtime) *asset_mtime = it->second.asset_mtime;
+    return cairo_surface_reference(it->second.surface);
+}
+
+void layer_cache_put(const LayerKey& key, cairo_surface_t* surface, int64_t asset_mtime) {
+    if (!surface || cairo_image_surface_get_format(surface) != CAIRO_FORMAT_ARGB32) return;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_layers.count(key_string(key))) return;
+    bool inserted;
+    insert_locked(key_string(key),
+                  LayerEntry{ cairo_surface_reference(surface), key, nullptr, "", asset_mtime }, inserted);
+}
+
+// "chars/./1.svg" and "chars/1.svg" name the same asset
+static std::string normalize_asset(const std::string& path) {
+    return fs::path(path).lexically_normal().string();
+}
+
+// Unlink every entry for the asset and delete its disk blobs. Returns the dropped
+// entries (surfaces still referenced) so the caller can re-render and release them.
+static std::vector<LayerEntry> take_asset_entries(const std::string& asset) {
+    const std::string want = normalize_asset(asset);
+    std::vector<LayerEntry> taken;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (auto it = g_layers.begin(); it != g_layers.end();) {
+            if (normalize_asset(it->second.key.asset) == want) {
+                taken.push_back(std::move(it->second));
+                auto next = std::next(it);
+                erase_locked(it);
+                it = next;
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (const LayerEntry& e : taken)
+        if (!e.blob.empty()) std::remove(e.blob.c_str());
+    return taken;
+}
+
+size_t layer_cache_invalidate_asset(const std::string& asset) {
+    std::vector<LayerEntry> taken = take_asset_entries(asset);
+    for (LayerEntry& e : taken) cairo_surface_destroy(e.surface);
+    return taken.size();
+}
+
+size_t layer_cache_refresh_asset(const std::string& asset) {
+    std::vector<LayerEntry> taken = take_asset_entries(asset);
+
+    // Every entry is unlinked before any re-render, so layers built from other
+    // cached layers of the same asset (nine-slice) pick up the fresh source
+    size_t refreshed = 0;
+    for (LayerEntry& e : taken) {
+        if (e.render) {
+            if (cairo_surface_t* s = layer_cache_get(e.key, e.render)) {
+                cairo_surface_destroy(s);
+                ++refreshed;
+            }
+        }
+        cairo_surface_destroy(e.surface);
+    }
+    return refreshed;
+}
+
+void layer_cache_set_disk_dir(const std::string& dir) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_disk_dir = dir;
+    g_disk_dir_init = true;
+}
+
+void layer_cache_clear() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (auto& kv : g_layers) cairo_surface_destroy(kv.second.surface);
+    g_layers.clear();
+    g_lru.clear();
+    g_bytes = 0;
+}
+
+void layer_cache_set_max_bytes(size_t bytes) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_max_bytes = bytes;
+    g_max_bytes_init = true;
+    evict_locked();
+}
+
+size_t layer_cache_bytes() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_bytes;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <functional>
+#include <cairo.h>
+
+// Identifies a rasterized static layer: source asset (SVG path or shape name),
+// colour key it was drawn with (may be empty) and pixel size.
+struct LayerKey {
+    std::string asset;
+    std::string color_key;
+    int width  = 0;
+    int height = 0;
+};
+
+// Renders the layer at the requested size. Return nullptr on failure.
+// The function is kept with the entry so layer_cache_refresh_asset() can run it
+// again later: capture by value, never locals by reference.
+using LayerRenderFn = std::function<cairo_surface_t*(int width, int height)>;
+
+// Return a new reference to the cached layer, rendering it (or reading it back
+// from the disk cache) on a miss. Caller must cairo_surface_destroy() the result
+// and treat the pixels as read-only. Returns nullptr if rendering fails.
+// A 0 side means "intrinsic" (render gets the 0 and fills it in, e.g. 200x0 keeps
+// an SVG's aspect ratio); those keys skip the disk cache.
+cairo_surface_t* layer_cache_get(const LayerKey& key, const LayerRenderFn& render);
+
+// Last-write time of an asset file in filesystem ticks, 0 if it cannot be read.
+// Layers are stamped with it when rendered, so a layer can be matched to the file
+// it was drawn from.
+const int64_t kLayerMtimeUnknown = INT64_MIN;
+int64_t layer_asset_mtime(const std::string& path);
+
+// New reference to a cached layer, or nullptr on a miss (never renders).
+// `asset_mtime` (optional) receives the asset mtime the layer was rendered from.
+cairo_surface_t* layer_cache_find(const LayerKey& key, int64_t* asset_mtime = nullptr);
+
+// Insert an already rasterized ARGB32 layer (e.g. from an atlas) drawn from the
+// asset as it was at `asset_mtime`. The cache takes its own reference; an existing
+// entry for the key is kept.
+void layer_cache_put(const LayerKey& key, cairo_surface_t* surface,
+                     int64_t asset_mtime = kLayerMtimeUnknown);
+
+// Directory for raw premultiplied ARGB32 blobs reused across process starts.
+// Empty disables the disk cache. Defaults to $LAYER_CACHE_DIR when set.
+void layer_cache_set_disk_dir(const std::string& dir);
+
+// Byte budget for in-memory layers; least recently used ones are dropped beyond it
+// (disk blobs are kept). Defaults to $LAYER_CACHE_MAX_MB, or 256 MB.
+void layer_cache_set_max_bytes(size_t bytes);
+size_t layer_cache_bytes();
+
+// Drop every in-memory layer (disk blobs are kept).
+void layer_cache_clear();
+
+// Drop every layer rendered from `asset` (any colour, any size) along with its disk
+// blobs. Surfaces already handed out stay valid. Returns the number dropped.
+size_t layer_cache_invalidate_asset(const std::string& asset);
+
+// Like invalidate, then re-render each dropped layer with its stored render
+// function so the next get() is a hit. Layers added with layer_cache_put() have no
+// render function and are only dropped. Returns the number re-rendered.
+size_t layer_cache_refresh_asset(const std::string& asset);
@@ -0,0 +1,220 @@
+// Layer cache behaviour: hits never re-render, the byte budget drops the least
+// recently used layers first (never the newest, never a surface still handed out),
+// disk blobs come back after a clear and go stale when the asset's mtime changes,
+// each layer keeps the mtime of the file it was rendered from,
+// and refresh/invalidate reach every size of one asset and nothing else.
+// Build: g++ -O2 -std=c++17 layer_cache_test.cpp layer_cache.cpp $(pkg-config --cflags --libs cairo)
+//        -o layer_cache_test
+#include "layer_cache.hpp"
+#include <cairo.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static int g_failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    if (ok) return;
+    ++g_failures;
+    if (g_failures <= 20) std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+}
+
+static int g_renders = 0;
+
+// Fills the layer with one opaque grey taken from the asset's first byte, so a
+// re-render after the file changes is visible in the pixels
+static LayerRenderFn fill_from(const std::string& asset) {
+    return [asset](int w, int h) -> cairo_surface_t* {
+        ++g_renders;
+        std::ifstream in(asset, std::ios::binary);
+        char c = 0;
+        if (!in.get(c)) return nullptr;
+        cairo_surface_t* s = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w > 0 ? w : 16, h > 0 ? h : 8);
+        cairo_t* cr = cairo_create(s);
+        const double v = (unsigned char)c / 255.0;
+        cairo_set_source_rgb(cr, v, v, v);
+        cairo_paint(cr);
+        cairo_destroy(cr);
+        return s;
+    };
+}
+
+static LayerRenderFn must_not_render() {
+    return [](int, int) -> cairo_surface_t* { ++g_renders; return nullptr; };
+}
+
+static int grey_of(cairo_surface_t* s) {
+    if (!s) return -1;
+    cairo_surface_flush(s);
+    return cairo_image_surface_get_data(s)[0];   // blue byte of the first pixel
+}
+
+// Writes one byte and moves the mtime on, as an editor saving the file would
+static void write_asset(const fs::path& path, char c, int step) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << c;
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now() + std::chrono::seconds(step), ec);
+}
+
+static bool cached(const std::string& asset, int w, int h, const std::string& color_key = "") {
+    cairo_surface_t* s = layer_cache_find({ asset, color_key, w, h });
+    if (s) cairo_surface_destroy(s);
+    return s != nullptr;
+}
+
+static size_t files_in(const fs::path& dir) {
+    size_t n = 0;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) ++n;
+    return n;
+}
+
+int main() {
+    const fs::path dir = fs::temp_directory_path() / "layer_cache_test";
+    const fs::path blobs = dir / "blobs";
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir, ec);
+    layer_cache_set_disk_dir("");
+    layer_cache_set_max_bytes(64u << 20);
+
+    const std::string a = (dir / "a.svg").string(), b = (dir / "b.svg").string();
+    const std::string c = (dir / "c.svg").string(), d = (dir / "d.svg").string();
+    write_asset(a, 'a', 0);
+    write_asset(b, 'b', 0);
+    write_asset(c, 'c', 0);
+    write_asset(d, 'd', 0);
+    const size_t layer = 64 * 64 * 4;
+
+    // ---- Hits ----
+    g_renders = 0;
+    cairo_surface_t* first = layer_cache_get({ a, "", 64, 64 }, fill_from(a));
+    cairo_surface_t* again = layer_cache_get({ a, "", 64, 64 }, must_not_render());
+    check(first && first == again && g_renders == 1, "second get is a hit on the same surface");
+    check(grey_of(first) == 'a', "rendered pixels");
+    check(layer_cache_bytes() == layer, "bytes after one layer");
+    cairo_surface_destroy(first);
+    cairo_surface_destroy(again);
+
+    // ---- Budget: least recently used first ----
+    layer_cache_clear();
+    check(layer_cache_bytes() == 0, "clear empties the cache");
+    layer_cache_set_max_bytes(3 * layer);
+    for (const std::string& asset : { a, b, c })
+        cairo_surface_destroy(layer_cache_get({ asset, "", 64, 64 }, fill_from(asset)));
+    cairo_surface_t* held_b = layer_cache_find({ b, "", 64, 64 });   // b is now the newest...
+    cairo_surface_destroy(layer_cache_find({ a, "", 64, 64 }));      // ...then a, leaving c the oldest
+    cairo_surface_destroy(layer_cache_get({ d, "", 64, 64 }, fill_from(d)));
+    check(!cached(c, 64, 64), "least recently used layer evicted");
+    check(cached(a, 64, 64) && cached(b, 64, 64) && cached(d, 64, 64), "recently used layers kept");
+    check(layer_cache_bytes() == 3 * layer, "bytes at the budget");
+
+    // Order is now d, b, a (find touches): shrinking to one layer keeps the newest
+    cairo_surface_destroy(layer_cache_find({ d, "", 64, 64 }));
+    layer_cache_set_max_bytes(layer);
+    check(cached(d, 64, 64) && !cached(a, 64, 64) && !cached(b, 64, 64), "shrunk budget keeps the newest");
+    check(grey_of(held_b) == 'b', "evicted surface still valid for its holder");
+    cairo_surface_destroy(held_b);
+
+    // A layer bigger than the whole budget is still kept until the next one arrives
+    layer_cache_set_max_bytes(1);
+    cairo_surface_t* big = layer_cache_get({ c, "", 128, 128 }, fill_from(c));
+    check(big && cached(c, 128, 128) && layer_cache_bytes() == 128 * 128 * 4, "over-budget layer kept alone");
+    cairo_surface_destroy(big);
+    layer_cache_clear();
+    layer_cache_set_max_bytes(64u << 20);
+
+    // ---- Disk blobs ----
+    layer_cache_set_disk_dir(blobs.string());
+    g_renders = 0;
+    cairo_surface_destroy(layer_cache_get({ a, "", 32, 16 }, fill_from(a)));
+    cairo_surface_destroy(layer_cache_get({ a, "", 0, 0 }, fill_from(a)));     // intrinsic
+    cairo_surface_destroy(layer_cache_get({ a, "", 24, 0 }, fill_from(a)));    // one side intrinsic
+    check(g_renders == 3 && files_in(blobs) == 1, "only the fully sized layer is written to disk");
+
+    layer_cache_clear();
+    g_renders = 0;
+    cairo_surface_t* reloaded = layer_cache_get({ a, "", 32, 16 }, must_not_render());
+    check(reloaded && g_renders == 0 && grey_of(reloaded) == 'a', "blob reloaded after clear without rendering");
+    check(reloaded && cairo_image_surface_get_width(reloaded) == 32 && cairo_image_surface_get_height(reloaded) == 16,
+          "blob size");
+    if (reloaded) cairo_surface_destroy(reloaded);
+
+    // A new mtime names a new blob: the old pixels are never read back
+    write_asset(a, 'A', 10);
+    layer_cache_clear();
+    g_renders = 0;
+    cairo_surface_t* edited = layer_cache_get({ a, "", 32, 16 }, fill_from(a));
+    check(g_renders == 1 && grey_of(edited) == 'A', "edited asset re-rendered, not read from the old blob");
+    if (edited) cairo_surface_destroy(edited);
+
+    // Layers carry the mtime of the file they were drawn from, not of the file now
+    int64_t stamp = 0;
+    cairo_surface_t* stamped = layer_cache_find({ a, "", 32, 16 }, &stamp);
+    check(stamped && stamp == layer_asset_mtime(a), "layer stamped with the asset mtime");
+    if (stamped) cairo_surface_destroy(stamped);
+    write_asset(a, 'B', 15);
+    stamped = layer_cache_find({ a, "", 32, 16 }, &stamp);
+    check(stamped && stamp != layer_asset_mtime(a), "stamp unchanged by a later edit");
+    if (stamped) cairo_surface_destroy(stamped);
+    cairo_surface_t* loose = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 4, 4);
+    layer_cache_put({ a, "loose", 4, 4 }, loose);
+    layer_cache_put({ a, "known", 4, 4 }, loose, 1234);
+    cairo_surface_destroy(loose);
+    cairo_surface_destroy(layer_cache_find({ a, "loose", 4, 4 }, &stamp));
+    check(stamp == kLayerMtimeUnknown, "put() without a stamp");
+    cairo_surface_destroy(layer_cache_find({ a, "known", 4, 4 }, &stamp));
+    check(stamp == 1234, "put() with a stamp");
+
+    // ---- Refresh and invalidate ----
+    // Two sizes and two colours of a, one layer of b, and a put() layer of a
+    layer_cache_clear();
+    fs::remove_all(blobs, ec);   // the blob from before the edit is an orphan nothing deletes
+    for (const LayerKey& k : { LayerKey{ a, "", 32, 16 }, LayerKey{ a, "", 48, 48 }, LayerKey{ a, "red", 48, 48 } })
+        cairo_surface_destroy(layer_cache_get(k, fill_from(a)));
+    cairo_surface_destroy(layer_cache_get({ b, "", 32, 16 }, fill_from(b)));
+    cairo_surface_t* atlas = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 8, 8);
+    layer_cache_put({ a, "atlas", 8, 8 }, atlas);
+    cairo_surface_destroy(atlas);
+    const size_t blobs_before = files_in(blobs);
+
+    write_asset(a, 'z', 20);
+    g_renders = 0;
+    const std::string a_unnormalized = (dir / "." / "a.svg").string();
+    check(layer_cache_refresh_asset(a_unnormalized) == 3 && g_renders == 3, "refresh re-renders every layer of a");
+    check(!cached(a, 8, 8, "atlas"), "refresh drops put() layers");
+    g_renders = 0;
+    for (const LayerKey& k : { LayerKey{ a, "", 32, 16 }, LayerKey{ a, "", 48, 48 }, LayerKey{ a, "red", 48, 48 } }) {
+        cairo_surface_t* s = layer_cache_get(k, must_not_render());
+        check(grey_of(s) == 'z', "refreshed pixels for " + k.color_key + std::to_string(k.width));
+        if (s) cairo_surface_destroy(s);
+    }
+    check(g_renders == 0, "gets after a refresh are hits");
+    cairo_surface_t* other = layer_cache_get({ b, "", 32, 16 }, must_not_render());
+    check(g_renders == 0 && grey_of(other) == 'b', "other assets untouched by refresh");
+    if (other) cairo_surface_destroy(other);
+    check(files_in(blobs) == blobs_before, "refresh replaces blobs rather than adding to them");
+
+    check(layer_cache_invalidate_asset(a) == 3, "invalidate drops every layer of a");
+    check(!cached(a, 32, 16) && !cached(a, 48, 48) && cached(b, 32, 16), "invalidate leaves other assets");
+    check(files_in(blobs) == 1, "invalidate deletes the asset's blobs");
+    g_renders = 0;
+    cairo_surface_destroy(layer_cache_get({ a, "", 32, 16 }, fill_from(a)));
+    check(g_renders == 1, "get after invalidate renders");
+
+    layer_cache_clear();
+    layer_cache_set_disk_dir("");
+    fs::remove_all(dir, ec);
+
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("layer_cache: hits, eviction order, disk blobs and refresh as expected\n");
+    return 0;
+}
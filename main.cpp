@@ -1,6 +1,10 @@
 #include "import_check.hpp"
-#include "rsv_render.hpp"
+#include "rsvg_render.hpp"
 #include "recolor_png.hpp"
 #include "countdown_timer.hpp"
 #include <iostream>
 
+int main() {
+    countdownTimer();
+    return 0;
+}
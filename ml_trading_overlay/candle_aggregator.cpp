@@ -0,0 +1,167 @@
+#include "candle_aggregator.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// ---- Timeframes ----
+
+int64_t timeframe_ms(Timeframe tf) {
+    switch (tf) {
+    case Timeframe::M1:  return 60000;
+    case Timeframe::M5:  return 5 * 60000;
+    case Timeframe::M15: return 15 * 60000;
+    case Timeframe::H1:  return 60 * 60000;
+    case Timeframe::D1:  return 24 * 60 * 60000;
+    }
+    return 60000;
+}
+
+const char* timeframe_name(Timeframe tf) {
+    switch (tf) {
+    case Timeframe::M1:  return "1m";
+    case Timeframe::M5:  return "5m";
+    case Timeframe::M15: return "15m";
+    case Timeframe::H1:  return "1h";
+    case Timeframe::D1:  return "1d";
+    }
+    return "?";
+}
+
+bool timeframe_parse(const std::string& s, Timeframe& tf) {
+    for (Timeframe t : { Timeframe::M1, Timeframe::M5, Timeframe::M15, Timeframe::H1, Timeframe::D1 }) {
+        if (s == timeframe_name(t)) { tf = t; return true; }
+    }
+    return false;
+}
+
+// ---- Aggregator ----
+
+// Open time of the bucket holding t (floor, also for times before 1970)
+static int64_t bucket_of(int64_t t, int64_t ms) {
+    int64_t q = t / ms;
+    if (t % ms < 0) --q;
+    return q * ms;
+}
+
+// b is later than a
+static Candle merge(const Candle& a, const Candle& b) {
+    return { a.time_ms, a.open, std::max(a.high, b.high), std::min(a.low, b.low), b.close, a.volume + b.volume };
+}
+
+CandleAggregator::CandleAggregator(std::vector<Timeframe> timeframes)
+    : timeframes_(std::move(timeframes)), frames_(timeframes_.size()) {
+    for (size_t i = 0; i < frames_.size(); ++i) frames_[i].ms = timeframe_ms(timeframes_[i]);
+}
+
+CandleAggregator::Frame* CandleAggregator::find(Timeframe tf) {
+    for (size_t i = 0; i < timeframes_.size(); ++i)
+        if (timeframes_[i] == tf) return &frames_[i];
+    return nullptr;
+}
+
+const CandleAggregator::Frame* CandleAggregator::find(Timeframe tf) const {
+    return const_cast<CandleAggregator*>(this)->find(tf);
+}
+
+Candle CandleAggregator::current(const Frame& f) const {
+    Candle bar = f.has_base ? merge(f.base, last_) : last_;
+    bar.time_ms = f.bucket;
+    return bar;
+}
+
+void CandleAggregator::push(const Candle& c) {
+    if (has_last_ && c.time_ms < last_.time_ms) return;
+
+    // A revision of the latest candle lands in the same buckets: the forming bars
+    // are base + last_, so replacing last_ is all there is to do
+    if (!has_last_ || c.time_ms != last_.time_ms) {
+        if (has_last_) step_ = step_ ? std::min(step_, c.time_ms - last_.time_ms) : c.time_ms - last_.time_ms;
+        for (Frame& f : frames_) {
+            int64_t bucket = bucket_of(c.time_ms, f.ms);
+            if (f.open && bucket != f.bucket) {
+                if (f.partial) f.dropped_leading = true;
+                else f.closed.append(current(f));
+                f.open = false;
+            } else if (f.open) {
+                f.base = f.has_base ? merge(f.base, last_) : last_;
+                f.has_base = true;
+            }
+            if (!f.open) {
+                f.open = true;
+                f.bucket = bucket;
+                f.has_base = false;
+                // Only the very first bar can start late; later gaps are missing data
+                f.partial = !has_last_ && c.time_ms != bucket;
+            }
+        }
+    }
+    last_ = c;
+    has_last_ = true;
+}
+
+const CandleSeries& CandleAggregator::closed(Timeframe tf) const {
+    static const CandleSeries empty;
+    const Frame* f = find(tf);
+    return f ? f->closed : empty;
+}
+
+bool CandleAggregator::dropped_leading(Timeframe tf) const {
+    const Frame* f = find(tf);
+    return f && f->dropped_leading;
+}
+
+bool CandleAggregator::forming(Timeframe tf, Candle& out, bool* complete) const {
+    const Frame* f = find(tf);
+    if (!f || !f->open) return false;
+    out = current(*f);
+    if (complete) *complete = !f->partial && step_ > 0 && last_.time_ms + step_ >= f->bucket + f->ms;
+    return true;
+}
+
+void CandleAggregator::bars(Timeframe tf, CandleColumns& out, bool complete_only) const {
+    closed(tf).decode_all(out);
+    Candle bar;
+    bool complete = false;
+    if (!forming(tf, bar, &complete) || (complete_only && !complete)) return;
+    out.time_ms.push_back(bar.time_ms);
+    out.open.push_back(bar.open);
+    out.high.push_back(bar.high);
+    out.low.push_back(bar.low);
+    out.close.push_back(bar.close);
+    out.volume.push_back(bar.volume);
+}
+
+// ---- Rebuild ----
+
+std::map<std::string, CandleAggregator> candle_rebuild(const CandleStore& m1,
+                                                       const std::vector<Timeframe>& timeframes,
+                                                       unsigned threads) {
+    std::map<std::string, CandleAggregator> out;
+    std::vector<std::pair<const CandleSeries*, CandleAggregator*>> jobs;
+    for (const auto& s : m1.all()) {
+        auto it = out.emplace(s.first, CandleAggregator(timeframes)).first;
+        jobs.emplace_back(&s.second, &it->second);
+    }
+    if (jobs.empty()) return out;
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, (unsigned)jobs.size());
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        CandleColumns cols;
+        for (size_t i = next++; i < jobs.size(); i = next++) {
+            const CandleSeries& src = *jobs[i].first;
+            CandleAggregator& agg = *jobs[i].second;
+            for (size_t b = 0; b < src.block_count(); ++b) {
+                src.decode_block(b, cols);
+                for (size_t j = 0; j < cols.time_ms.size(); ++j) agg.push(cols.at(j));
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) pool.emplace_back(worker);
+    for (auto& th : pool) th.join();
+    return out;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "candle_store.hpp"
+
+// Builds higher-timeframe OHLCV bars from a 1m stream. Bars are aligned to UTC
+// (a 15m bar opens at :00/:15/:30/:45, a 1d bar at 00:00Z) and stamped with
+// their open time. Finished bars go into a CandleSeries per timeframe; the
+// forming bar is kept aside so it can be read (and revised) while it builds.
+// If the first input candle falls mid-bucket, that first bar lacks its real open
+// (and part of its range), so it is dropped when it closes rather than stored.
+
+enum class Timeframe { M1, M5, M15, H1, D1 };
+
+int64_t timeframe_ms(Timeframe tf);
+const char* timeframe_name(Timeframe tf);            // "1m", "5m", "15m", "1h", "1d"
+bool timeframe_parse(const std::string& s, Timeframe& tf);
+
+class CandleAggregator {
+public:
+    explicit CandleAggregator(std::vector<Timeframe> timeframes =
+                                  { Timeframe::M5, Timeframe::M15, Timeframe::H1, Timeframe::D1 });
+
+    // O(1) per timeframe. Candles must arrive in ascending open time; one with
+    // the same time as the previous replaces it (exchanges resend the live
+    // minute until it closes), anything older is ignored. Input can be any
+    // interval that divides the timeframes, not just 1m.
+    void push(const Candle& c);
+
+    const std::vector<Timeframe>& timeframes() const { return timeframes_; }
+    // Finished bars only (a partial leading bar is left out)
+    const CandleSeries& closed(Timeframe tf) const;
+    // True if a partial leading bar was dropped from closed(tf)
+    bool dropped_leading(Timeframe tf) const;
+    // The bar currently being built, if any. complete: it already holds the input
+    // candle that ends its bucket (judged from the smallest input spacing seen) and
+    // did not start mid-bucket, so no later input will change it except a revision.
+    bool forming(Timeframe tf, Candle& out, bool* complete = nullptr) const;
+    // Finished bars plus the forming one, decoded into out; with complete_only the
+    // forming bar is left out unless it is complete
+    void bars(Timeframe tf, CandleColumns& out, bool complete_only = false) const;
+
+private:
+    struct Frame {
+        int64_t ms;
+        bool open = false;
+        int64_t bucket = 0;   // open time of the forming bar
+        Candle base;          // forming bar without the latest input candle
+        bool has_base = false;
+        bool partial = false;          // forming bar is the first and began mid-bucket
+        bool dropped_leading = false;
+        CandleSeries closed;
+    };
+
+    Frame* find(Timeframe tf);
+    const Frame* find(Timeframe tf) const;
+    Candle current(const Frame& f) const;
+
+    std::vector<Timeframe> timeframes_;
+    std::vector<Frame> frames_;
+    Candle last_{};           // latest input candle (may still be revised)
+    bool has_last_ = false;
+    int64_t step_ = 0;        // smallest spacing between input candles, 0 until known
+};
+
+// Rebuilds every symbol of a 1m store through its own aggregator, one symbol per
+// worker (threads == 0: hardware_concurrency). The aggregators keep their forming
+// bars, so live candles can be pushed on top of the rebuilt history.
+std::map<std::string, CandleAggregator> candle_rebuild(
+    const CandleStore& m1,
+    const std::vector<Timeframe>& timeframes = { Timeframe::M5, Timeframe::M15, Timeframe::H1, Timeframe::D1 },
+    unsigned threads = 0);
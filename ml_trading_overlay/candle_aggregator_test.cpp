@@ -0,0 +1,168 @@
+// CandleAggregator against a plain group-by over the same 1m candles: every
+// closed and forming bar must match exactly, with revisions of the live minute,
+// gaps, a start mid-bucket (that first bar is dropped) and an end that leaves some
+// timeframes complete and others still forming. candle_rebuild must agree too.
+// Build: g++ -O2 -std=c++17 candle_aggregator_test.cpp candle_aggregator.cpp candle_store.cpp
+//        -pthread -o candle_aggregator_test
+#include "candle_aggregator.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+static int g_failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    if (ok) return;
+    ++g_failures;
+    if (g_failures <= 20) std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+}
+
+static bool same(const Candle& a, const Candle& b) {
+    return a.time_ms == b.time_ms && std::memcmp(&a.open, &b.open, 5 * sizeof(double)) == 0;
+}
+
+static int64_t floor_to(int64_t t, int64_t ms) {
+    int64_t q = t / ms;
+    if (t % ms < 0) --q;
+    return q * ms;
+}
+
+// Reference: bucket the final candles, in order
+static std::vector<Candle> group_by(const std::vector<Candle>& in, int64_t ms) {
+    std::map<int64_t, Candle> bars;
+    for (const Candle& c : in) {
+        const int64_t b = floor_to(c.time_ms, ms);
+        auto it = bars.find(b);
+        if (it == bars.end()) {
+            bars[b] = { b, c.open, c.high, c.low, c.close, c.volume };
+        } else {
+            Candle& bar = it->second;
+            bar.high = std::max(bar.high, c.high);
+            bar.low = std::min(bar.low, c.low);
+            bar.close = c.close;
+            bar.volume += c.volume;
+        }
+    }
+    std::vector<Candle> out;
+    for (const auto& kv : bars) out.push_back(kv.second);
+    return out;
+}
+
+static Candle random_candle(int64_t t, std::mt19937_64& rng) {
+    const double o = 100.0 + (double)(rng() % 10000) / 100.0;
+    const double c = o + ((double)(rng() % 201) - 100.0) / 100.0;
+    return { t, o, std::max(o, c) + (double)(rng() % 30) / 100.0, std::min(o, c) - (double)(rng() % 30) / 100.0,
+             c, (double)(rng() % 100000) / 1000.0 };
+}
+
+struct Feed {
+    std::vector<Candle> pushes;   // what the aggregator sees, revisions included
+    std::vector<Candle> final;    // one candle per minute, as last revised
+};
+
+// 1m candles from `start` through `end` (inclusive), with gaps and revisions;
+// the first and last minute are always present
+static Feed make_feed(int64_t start, int64_t end, std::mt19937_64& rng) {
+    Feed f;
+    for (int64_t t = start; t <= end; t += 60000) {
+        if (t != start && t != end && rng() % 40 == 0) continue;   // gap
+        Candle c = random_candle(t, rng);
+        f.pushes.push_back(c);
+        for (unsigned r = (unsigned)(rng() % 4 == 0 ? 1 + rng() % 3 : 0); r; --r) {
+            c = random_candle(t, rng);   // exchange resends the live minute
+            f.pushes.push_back(c);
+        }
+        if (rng() % 50 == 0) f.pushes.push_back(random_candle(t - 120000, rng));   // stale, ignored
+        f.final.push_back(c);
+    }
+    return f;
+}
+
+static const Timeframe kAll[] = { Timeframe::M1, Timeframe::M5, Timeframe::M15, Timeframe::H1, Timeframe::D1 };
+
+static void compare(const std::string& name, const CandleAggregator& agg, const Feed& feed) {
+    for (Timeframe tf : kAll) {
+        const std::string what = name + " " + timeframe_name(tf);
+        const int64_t ms = timeframe_ms(tf);
+        std::vector<Candle> want = group_by(feed.final, ms);
+
+        // The first bar is dropped when the feed starts mid-bucket
+        const bool partial_first = feed.final.front().time_ms != want.front().time_ms;
+        check(agg.dropped_leading(tf) == (partial_first && want.size() > 1), what + ": dropped_leading");
+        Candle forming;
+        bool complete = false;
+        check(agg.forming(tf, forming, &complete), what + ": has a forming bar");
+        check(same(forming, want.back()), what + ": forming bar");
+        const int64_t last = feed.final.back().time_ms;
+        check(complete == (!(partial_first && want.size() == 1) && last + 60000 == want.back().time_ms + ms),
+              what + ": forming bar complete");
+
+        if (partial_first) want.erase(want.begin());
+        const CandleSeries& closed = agg.closed(tf);
+        check(closed.size() + 1 == want.size() || (want.empty() && closed.empty()), what + ": closed count");
+        CandleColumns cols;
+        closed.decode_all(cols);
+        for (size_t i = 0; i < cols.time_ms.size() && i < want.size(); ++i)
+            check(same(cols.at(i), want[i]), what + ": closed bar " + std::to_string(i));
+
+        agg.bars(tf, cols, true);
+        check(cols.time_ms.size() == closed.size() + (complete ? 1 : 0), what + ": complete_only bars");
+        agg.bars(tf, cols);
+        check(cols.time_ms.size() == closed.size() + 1, what + ": bars");
+    }
+}
+
+int main() {
+    std::mt19937_64 rng(7);
+    const std::vector<Timeframe> all(std::begin(kAll), std::end(kAll));
+
+    // 2024-01-01T00:07Z .. 2024-01-04T05:14Z: mid-bucket start for 5m and up; the
+    // last minute closes the 5m and 15m buckets but not 1h or 1d
+    const int64_t day0 = 1704067200000;
+    {
+        Feed feed = make_feed(day0 + 7 * 60000, day0 + 3 * 86400000LL + 5 * 3600000LL + 14 * 60000, rng);
+        CandleAggregator agg(all);
+        for (const Candle& c : feed.pushes) agg.push(c);
+        compare("mid-start", agg, feed);
+    }
+    // Aligned start, ends exactly on a day boundary: every bar complete
+    {
+        Feed feed = make_feed(day0, day0 + 2 * 86400000LL - 60000, rng);
+        CandleAggregator agg(all);
+        for (const Candle& c : feed.pushes) agg.push(c);
+        compare("aligned", agg, feed);
+    }
+    // Shorter than one bucket of the larger timeframes, and before 1970
+    {
+        Feed feed = make_feed(-86400000LL - 45 * 60000, -86400000LL - 60000 * 3, rng);
+        CandleAggregator agg(all);
+        for (const Candle& c : feed.pushes) agg.push(c);
+        compare("short", agg, feed);
+    }
+
+    // candle_rebuild over a store matches pushing each symbol's final candles
+    {
+        CandleStore store;
+        std::map<std::string, Feed> feeds;
+        for (const char* sym : { "AAA", "BBB", "CCC", "DDD", "EEE" }) {
+            const int64_t start = day0 + (int64_t)(rng() % 1000) * 60000;
+            feeds[sym] = make_feed(start, start + (int64_t)(2000 + rng() % 3000) * 60000, rng);
+            for (const Candle& c : feeds[sym].final) store.series(sym).append(c);
+        }
+        const auto rebuilt = candle_rebuild(store, all, 3);
+        check(rebuilt.size() == feeds.size(), "rebuild: symbols");
+        for (const auto& kv : rebuilt) compare("rebuild " + kv.first, kv.second, feeds[kv.first]);
+    }
+
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("candle_aggregator: matches group-by on every timeframe\n");
+    return 0;
+}
@@ -0,0 +1,441 @@
+#include "candle_store.hpp"
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// ---- Bit streams ----
+
+// MSB-first: the first bit written is the top bit of words[0]
+void CandleSeries::Stream::put(uint64_t v, int n) {
+    if (n < 64) v &= (uint64_t(1) << n) - 1;
+    int off = int(bits & 63);
+    if (off == 0) words.push_back(0);
+    int room = 64 - off;
+    if (n <= room) {
+        words.back() |= v << (room - n);
+    } else {
+        words.back() |= v >> (n - room);
+        words.push_back(v << (64 - (n - room)));
+    }
+    bits += uint64_t(n);
+}
+
+namespace {
+
+struct BitReader {
+    const uint64_t* w;
+    uint64_t pos = 0;
+
+    explicit BitReader(const std::vector<uint64_t>& words) : w(words.data()) {}
+
+    uint64_t get(int n) {
+        size_t i = size_t(pos >> 6);
+        int off = int(pos & 63);
+        pos += uint64_t(n);
+        uint64_t hi = w[i] << off;
+        if (off + n <= 64) return hi >> (64 - n);
+        return (hi >> (64 - n)) | (w[i + 1] >> (128 - off - n));
+    }
+    bool bit() { return get(1) != 0; }
+};
+
+inline uint64_t double_bits(double v) { uint64_t b; std::memcpy(&b, &v, 8); return b; }
+inline double bits_double(uint64_t b) { double v; std::memcpy(&v, &b, 8); return v; }
+
+const double kPow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8 };
+const int kMaxScale = 8;
+
+// v == scaled / 10^scale exactly (the decoder computes it that way)
+bool to_scaled(double v, int scale, int64_t& scaled) {
+    double x = v * kPow10[scale];
+    if (!(x > -9007199254740992.0 && x < 9007199254740992.0)) return false;   // also NaN
+    scaled = std::llround(x);
+    return double_bits(double(scaled) / kPow10[scale]) == double_bits(v);
+}
+
+// Fewest decimal places that represent v exactly, or -1
+int decimals(double v) {
+    int64_t n;
+    for (int k = 0; k <= kMaxScale; ++k)
+        if (to_scaled(v, k, n)) return k;
+    return -1;
+}
+
+inline uint64_t zigzag(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+inline int64_t unzigzag(uint64_t z) { return int64_t(z >> 1) ^ -int64_t(z & 1); }
+
+void decode_times(const std::vector<uint64_t>& words, size_t count, int64_t first, int64_t* out) {
+    // Unsigned, like the encoder: arbitrary timestamps wrap instead of overflowing
+    BitReader r(words);
+    uint64_t t = uint64_t(first), delta = 0;
+    out[0] = first;
+    for (size_t i = 1; i < count; ++i) {
+        // Prefix '0' / '10' / '110' / '1110' / '11110' / '11111' selects 0/7/9/12/32/64 bits
+        int64_t dod = 0;
+        if (r.bit()) {
+            static const int kWidths[] = { 7, 9, 12, 32 };
+            int width = 64;
+            for (int k = 0; k < 4; ++k) {
+                if (!r.bit()) { width = kWidths[k]; break; }
+            }
+            dod = unzigzag(r.get(width));
+        }
+        delta += uint64_t(dod);
+        t += delta;
+        out[i] = int64_t(t);
+    }
+}
+
+void decode_doubles(const std::vector<uint64_t>& words, size_t count, double* out) {
+    BitReader r(words);
+    int scale = int(r.get(4));
+    uint64_t prev = r.get(64);
+    out[0] = bits_double(prev);
+
+    if (scale <= kMaxScale) {
+        // Prefix '0' / '10' / '110' / '1110' / '11110' selects a 0/7/12/20/32-bit
+        // delta of the scaled integer; '11111' escapes a raw double
+        const double div = kPow10[scale];
+        int64_t scaled = 0;
+        to_scaled(out[0], scale, scaled);
+        for (size_t i = 1; i < count; ++i) {
+            static const int kWidths[] = { 7, 12, 20, 32 };
+            int width = 0;
+            if (r.bit()) {
+                width = -1;
+                for (int k = 0; k < 4; ++k) {
+                    if (!r.bit()) { width = kWidths[k]; break; }
+                }
+            }
+            if (width < 0) {
+                int64_t n;
+                out[i] = bits_double(r.get(64));
+                if (to_scaled(out[i], scale, n)) scaled = n;
+                continue;
+            }
+            if (width) scaled += unzigzag(r.get(width));
+            out[i] = double(scaled) / div;
+        }
+        return;
+    }
+
+    int leading = 0, trailing = 0;
+    for (size_t i = 1; i < count; ++i) {
+        if (r.bit()) {
+            if (r.bit()) {
+                leading = int(r.get(5));
+                int len = int(r.get(6)) + 1;
+                trailing = 64 - leading - len;
+            }
+            prev ^= r.get(64 - leading - trailing) << trailing;
+        }
+        out[i] = bits_double(prev);
+    }
+}
+
+}  // namespace
+
+// ---- Encoding ----
+
+void CandleSeries::put_xor(Stream& s, ValueState& st, uint64_t b) {
+    uint64_t x = b ^ st.prev;
+    st.prev = b;
+    if (!x) {
+        s.put(0, 1);
+        return;
+    }
+    int leading = __builtin_clzll(x), trailing = __builtin_ctzll(x);
+    if (leading > 31) leading = 31;   // 5-bit field
+    if (st.leading >= 0 && leading >= st.leading && trailing >= st.trailing) {
+        // Fits in the previous window: control '10' and just the window bits
+        s.put(0x2, 2);
+        s.put(x >> st.trailing, 64 - st.leading - st.trailing);
+    } else {
+        // Control '11', 5 bits of leading zeros, 6 bits of (length - 1), then the bits
+        int len = 64 - leading - trailing;
+        s.put(0x3, 2);
+        s.put(uint64_t(leading), 5);
+        s.put(uint64_t(len - 1), 6);
+        s.put(x >> trailing, len);
+        st.leading = leading;
+        st.trailing = trailing;
+    }
+}
+
+void CandleSeries::put_value(Stream& s, ValueState& st, int col, double v, bool first) {
+    uint64_t b = double_bits(v);
+    int& hint = scale_hint_[col];
+    if (first) {
+        // 4-bit header: decimal places for the block, or 15 for XOR mode
+        int d = decimals(v);
+        st.scale = -1;
+        if (d >= 0) {
+            if (hint > d && to_scaled(v, hint, st.scaled)) st.scale = hint;
+            else if (to_scaled(v, d, st.scaled)) st.scale = d;
+            if (d > hint) hint = d;
+        }
+        s.put(st.scale < 0 ? 15 : uint64_t(st.scale), 4);
+        s.put(b, 64);
+        st.prev = b;
+        return;
+    }
+    if (st.scale < 0) {
+        put_xor(s, st, b);
+        return;
+    }
+
+    int64_t scaled;
+    if (to_scaled(v, st.scale, scaled)) {
+        uint64_t z = zigzag(scaled - st.scaled);
+        if (z < (uint64_t(1) << 32)) {
+            if (z == 0) s.put(0, 1);
+            else if (z < (uint64_t(1) << 7)) { s.put(0x2, 2); s.put(z, 7); }
+            else if (z < (uint64_t(1) << 12)) { s.put(0x6, 3); s.put(z, 12); }
+            else if (z < (uint64_t(1) << 20)) { s.put(0xe, 4); s.put(z, 20); }
+            else { s.put(0x1e, 5); s.put(z, 32); }
+            st.scaled = scaled;
+            return;
+        }
+    } else {
+        // More decimals than this block was started with: start the next one wider
+        int d = decimals(v);
+        if (d > hint) hint = d;
+    }
+    s.put(0x1f, 5);
+    s.put(b, 64);
+    if (to_scaled(v, st.scale, scaled)) st.scaled = scaled;
+}
+
+void CandleSeries::seal(Block& b) {
+    for (Stream& s : b.col) s.words.shrink_to_fit();
+}
+
+void CandleSeries::append(const Candle& c) {
+    if (blocks_.empty() || blocks_.back().count == kBlockSize) {
+        if (!blocks_.empty()) seal(blocks_.back());
+        blocks_.emplace_back();
+        blocks_.back().first_time_ms = c.time_ms;
+        blocks_.back().prev_time = c.time_ms;
+    }
+    Block& b = blocks_.back();
+    bool first = b.count == 0;
+
+    if (!first) {
+        // Modular arithmetic, so far-apart or out-of-order times cannot overflow;
+        // the decoder wraps back to the same values
+        uint64_t delta = uint64_t(c.time_ms) - uint64_t(b.prev_time);
+        uint64_t z = zigzag(int64_t(delta - uint64_t(b.prev_delta)));
+        Stream& s = b.col[0];
+        if (z == 0) s.put(0, 1);
+        else if (z < (uint64_t(1) << 7)) { s.put(0x2, 2); s.put(z, 7); }
+        else if (z < (uint64_t(1) << 9)) { s.put(0x6, 3); s.put(z, 9); }
+        else if (z < (uint64_t(1) << 12)) { s.put(0xe, 4); s.put(z, 12); }
+        else if (z < (uint64_t(1) << 32)) { s.put(0x1e, 5); s.put(z, 32); }
+        else { s.put(0x1f, 5); s.put(z, 64); }
+        b.prev_delta = int64_t(delta);
+        b.prev_time = c.time_ms;
+    }
+
+    const double v[kColumns - 1] = { c.open, c.high, c.low, c.close, c.volume };
+    for (int k = 0; k < kColumns - 1; ++k) put_value(b.col[k + 1], b.v[k], k, v[k], first);
+
+    ++b.count;
+    ++count_;
+    last_time_ms_ = c.time_ms;
+}
+
+// ---- Decoding ----
+
+void CandleColumns::clear() {
+    time_ms.clear();
+    open.clear();
+    high.clear();
+    low.clear();
+    close.clear();
+    volume.clear();
+}
+
+static std::vector<double>* double_column(CandleColumns& out, int k) {
+    std::vector<double>* cols[] = { &out.open, &out.high, &out.low, &out.close, &out.volume };
+    return cols[k];
+}
+
+void CandleSeries::decode_block(size_t bi, CandleColumns& out, unsigned fields) const {
+    out.clear();
+    const Block& b = blocks_[bi];
+    if (fields & kFieldTime) {
+        out.time_ms.resize(b.count);
+        decode_times(b.col[0].words, b.count, b.first_time_ms, out.time_ms.data());
+    }
+    for (int k = 0; k < kColumns - 1; ++k) {
+        if (!(fields & (1u << (k + 1)))) continue;
+        std::vector<double>& col = *double_column(out, k);
+        col.resize(b.count);
+        decode_doubles(b.col[k + 1].words, b.count, col.data());
+    }
+}
+
+void CandleSeries::decode_all(CandleColumns& out, unsigned fields) const {
+    out.clear();
+    if (fields & kFieldTime) out.time_ms.resize(count_);
+    for (int k = 0; k < kColumns - 1; ++k)
+        if (fields & (1u << (k + 1))) double_column(out, k)->resize(count_);
+
+    size_t at = 0;
+    for (const Block& b : blocks_) {
+        if (fields & kFieldTime)
+            decode_times(b.col[0].words, b.count, b.first_time_ms, out.time_ms.data() + at);
+        for (int k = 0; k < kColumns - 1; ++k) {
+            if (!(fields & (1u << (k + 1)))) continue;
+            decode_doubles(b.col[k + 1].words, b.count, double_column(out, k)->data() + at);
+        }
+        at += b.count;
+    }
+}
+
+size_t CandleSeries::compressed_bytes() const {
+    size_t n = blocks_.capacity() * sizeof(Block);
+    for (const Block& b : blocks_)
+        for (const Stream& s : b.col) n += s.words.capacity() * sizeof(uint64_t);
+    return n;
+}
+
+// ---- Store ----
+
+const CandleSeries* CandleStore::find(const std::string& symbol) const {
+    auto it = series_.find(symbol);
+    return it == series_.end() ? nullptr : &it->second;
+}
+
+size_t CandleStore::candles() const {
+    size_t n = 0;
+    for (const auto& s : series_) n += s.second.size();
+    return n;
+}
+
+size_t CandleStore::compressed_bytes() const {
+    size_t n = 0;
+    for (const auto& s : series_) n += s.second.compressed_bytes();
+    return n;
+}
+
+size_t CandleStore::raw_bytes() const {
+    size_t n = 0;
+    for (const auto& s : series_) n += s.second.raw_bytes();
+    return n;
+}
+
+// ---- Time stamps ----
+
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant's algorithm)
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = unsigned(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + int64_t(doe) - 719468;
+}
+
+static void civil_from_days(int64_t z, int& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = unsigned(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = int(int64_t(yoe) + era * 400 + (m <= 2));
+}
+
+// Reads exactly n digits at s[i]
+static bool read_digits(const std::string& s, size_t& i, int n, int& v) {
+    v = 0;
+    for (int k = 0; k < n; ++k, ++i) {
+        if (i >= s.size() || !std::isdigit((unsigned char)s[i])) return false;
+        v = v * 10 + (s[i] - '0');
+    }
+    return true;
+}
+
+bool candle_parse_time(const std::string& raw, int64_t& time_ms) {
+    size_t b = raw.find_first_not_of(" \t\"");
+    size_t e = raw.find_last_not_of(" \t\r\n\"");
+    if (b == std::string::npos) return false;
+    const std::string s = raw.substr(b, e - b + 1);
+
+    // Epoch milliseconds
+    size_t digits = s[0] == '-' ? 1 : 0;
+    if (digits < s.size() && s.find_first_not_of("0123456789", digits) == std::string::npos) {
+        // Out of int64 range is a parse failure, not an exception
+        const char* end = s.data() + s.size();
+        auto res = std::from_chars(s.data(), end, time_ms);
+        return res.ec == std::errc() && res.ptr == end;
+    }
+
+    size_t i = 0;
+    int y, mo, d, h, mi, sec = 0, ms = 0;
+    if (!read_digits(s, i, 4, y) || i >= s.size() || s[i++] != '-') return false;
+    if (!read_digits(s, i, 2, mo) || i >= s.size() || s[i++] != '-') return false;
+    if (!read_digits(s, i, 2, d)) return false;
+    if (mo < 1 || mo > 12 || d < 1 || d > 31) return false;
+    if (i < s.size() && (s[i] == 'T' || s[i] == 't' || s[i] == ' ')) {
+        ++i;
+        if (!read_digits(s, i, 2, h) || i >= s.size() || s[i++] != ':') return false;
+        if (!read_digits(s, i, 2, mi)) return false;
+        if (i < s.size() && s[i] == ':') {
+            ++i;
+            if (!read_digits(s, i, 2, sec)) return false;
+            if (i < s.size() && (s[i] == '.' || s[i] == ',')) {
+                ++i;
+                int scale = 100;
+                for (; i < s.size() && std::isdigit((unsigned char)s[i]); ++i, scale /= 10)
+                    ms += (s[i] - '0') * scale;
+            }
+        }
+    } else {
+        h = mi = 0;
+    }
+
+    int64_t offset_min = 0;
+    if (i < s.size()) {
+        char c = s[i++];
+        if (c == 'Z' || c == 'z') {
+            // UTC
+        } else if (c == '+' || c == '-') {
+            int oh, om = 0;
+            if (!read_digits(s, i, 2, oh)) return false;
+            if (i < s.size() && s[i] == ':') ++i;
+            if (i < s.size() && !read_digits(s, i, 2, om)) return false;
+            offset_min = (c == '-' ? -1 : 1) * (oh * 60 + om);
+        } else {
+            return false;
+        }
+        if (i != s.size()) return false;
+    }
+
+    int64_t secs = days_from_civil(y, unsigned(mo), unsigned(d)) * 86400 + h * 3600 + mi * 60 + sec;
+    time_ms = (secs - offset_min * 60) * 1000 + ms;
+    return true;
+}
+
+std::string candle_format_time(int64_t time_ms) {
+    int64_t days = time_ms / 86400000, rem = time_ms % 86400000;
+    if (rem < 0) { rem += 86400000; --days; }
+    int y;
+    unsigned m, d;
+    civil_from_days(days, y, m, d);
+    int secs = int(rem / 1000), ms = int(rem % 1000);
+
+    char buf[40];
+    if (ms)
+        std::snprintf(buf, sizeof(buf), "%04d-%02u-%02uT%02d:%02d:%02d.%03dZ",
+                      y, m, d, secs / 3600, secs / 60 % 60, secs % 60, ms);
+    else
+        std::snprintf(buf, sizeof(buf), "%04d-%02u-%02uT%02d:%02d:%02dZ",
+                      y, m, d, secs / 3600, secs / 60 % 60, secs % 60);
+    return buf;
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Compressed in-memory OHLCV history. Each symbol's series is stored column by
+// column in blocks of kBlockSize candles: open times as delta-of-delta, prices
+// and volume as Gorilla-style XOR of consecutive doubles. Exchange quotes are
+// short decimals, whose binary mantissas XOR badly, so a column whose values are
+// exact multiples of 10^-k (k <= 8) is instead stored as variable-width deltas of
+// the scaled integer; anything else in it is escaped as a raw double.
+// A regular 1m series costs about a bit per timestamp and 10-25 bits per value.
+// Decoding is block-wise into caller-owned scratch columns, and can skip columns
+// the caller does not need.
+
+struct Candle {
+    int64_t time_ms;   // open time, ms since the Unix epoch (UTC)
+    double open, high, low, close, volume;
+};
+
+enum CandleField : unsigned {
+    kFieldTime   = 1u << 0,
+    kFieldOpen   = 1u << 1,
+    kFieldHigh   = 1u << 2,
+    kFieldLow    = 1u << 3,
+    kFieldClose  = 1u << 4,
+    kFieldVolume = 1u << 5,
+    kFieldAll    = 0x3f,
+};
+
+// Scratch buffers for decoding; reuse one across blocks to avoid reallocation.
+// Columns that were not requested are left empty.
+struct CandleColumns {
+    std::vector<int64_t> time_ms;
+    std::vector<double> open, high, low, close, volume;
+
+    void clear();
+    Candle at(size_t i) const { return { time_ms[i], open[i], high[i], low[i], close[i], volume[i] }; }
+};
+
+class CandleSeries {
+public:
+    static const size_t kBlockSize = 1024;
+    static const int kColumns = 6;   // time + 5 doubles, in CandleField order
+
+    // Candles are expected in ascending open time; anything else still
+    // round-trips but costs a full 64-bit timestamp
+    void append(const Candle& c);
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    size_t block_count() const { return blocks_.size(); }
+    size_t block_size(size_t b) const { return blocks_[b].count; }
+    int64_t first_time_ms() const { return blocks_.empty() ? 0 : blocks_.front().first_time_ms; }
+    int64_t last_time_ms() const { return last_time_ms_; }
+
+    // Replace out's requested columns with block b's candles
+    void decode_block(size_t b, CandleColumns& out, unsigned fields = kFieldAll) const;
+    // Append every block to out (out is cleared first)
+    void decode_all(CandleColumns& out, unsigned fields = kFieldAll) const;
+
+    // Bytes held by the encoded streams vs. the same data as plain Candle structs
+    size_t compressed_bytes() const;
+    size_t raw_bytes() const { return count_ * sizeof(Candle); }
+
+private:
+    struct Stream {
+        std::vector<uint64_t> words;
+        uint64_t bits = 0;
+        void put(uint64_t v, int n);
+    };
+    // Per-column encoder state; only meaningful while the block is open
+    struct ValueState {
+        int scale = -1;                   // decimal places, or -1 for XOR mode
+        int64_t scaled = 0;               // previous value * 10^scale
+        uint64_t prev = 0;
+        int leading = -1, trailing = 0;   // leading < 0: no window yet
+    };
+    struct Block {
+        size_t count = 0;
+        int64_t first_time_ms = 0;
+        Stream col[kColumns];
+        int64_t prev_time = 0, prev_delta = 0;
+        ValueState v[kColumns - 1];
+    };
+
+    static void put_xor(Stream& s, ValueState& st, uint64_t bits);
+    void put_value(Stream& s, ValueState& st, int col, double v, bool first);
+    void seal(Block& b);
+
+    std::vector<Block> blocks_;
+    size_t count_ = 0;
+    int64_t last_time_ms_ = 0;
+    int scale_hint_[kColumns - 1] = {};   // most decimals seen per column, for new blocks
+};
+
+// Series per symbol
+class CandleStore {
+public:
+    CandleSeries& series(const std::string& symbol) { return series_[symbol]; }
+    const CandleSeries* find(const std::string& symbol) const;
+    const std::map<std::string, CandleSeries>& all() const { return series_; }
+
+    size_t candles() const;
+    size_t compressed_bytes() const;
+    size_t raw_bytes() const;
+
+private:
+    std::map<std::string, CandleSeries> series_;
+};
+
+// "YYYY-MM-DD[T ]HH:MM[:SS[.fff]][Z|+hh:mm|-hh:mm]" or epoch milliseconds
+bool candle_parse_time(const std::string& s, int64_t& time_ms);
+// "YYYY-MM-DDTHH:MM:SSZ", with ".fff" only when the milliseconds are non-zero
+std::string candle_format_time(int64_t time_ms);
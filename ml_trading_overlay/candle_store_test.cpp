@@ -0,0 +1,165 @@
+// CandleSeries must round-trip every candle bit for bit: NaN payloads, -0.0,
+// infinities, short decimals and raw doubles mixed in one column, irregular and
+// out-of-order times, and series ending on and around the 1024-candle block edge.
+// Build: g++ -O2 -std=c++17 candle_store_test.cpp candle_store.cpp -o candle_store_test
+#include "candle_store.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+static int g_failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    if (ok) return;
+    ++g_failures;
+    if (g_failures <= 20) std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+}
+
+static uint64_t bits_of(double v) { uint64_t b; std::memcpy(&b, &v, 8); return b; }
+
+static double from_bits(uint64_t b) { double v; std::memcpy(&v, &b, 8); return v; }
+
+// Appends `in` to a fresh series and compares what comes back, whole and per block
+static void round_trip(const std::string& name, const std::vector<Candle>& in) {
+    CandleSeries s;
+    for (const Candle& c : in) s.append(c);
+    check(s.size() == in.size(), name + ": size");
+    check(s.block_count() == (in.size() + CandleSeries::kBlockSize - 1) / CandleSeries::kBlockSize,
+          name + ": block count");
+    if (!in.empty()) {
+        check(s.first_time_ms() == in.front().time_ms, name + ": first_time_ms");
+        check(s.last_time_ms() == in.back().time_ms, name + ": last_time_ms");
+    }
+
+    CandleColumns cols;
+    s.decode_all(cols);
+    check(cols.time_ms.size() == in.size(), name + ": decoded size");
+    for (size_t i = 0; i < in.size() && i < cols.time_ms.size(); ++i) {
+        const Candle got = cols.at(i);
+        const Candle& want = in[i];
+        const double gv[] = { got.open, got.high, got.low, got.close, got.volume };
+        const double wv[] = { want.open, want.high, want.low, want.close, want.volume };
+        bool same = got.time_ms == want.time_ms;
+        for (int k = 0; k < 5; ++k) same = same && bits_of(gv[k]) == bits_of(wv[k]);
+        check(same, name + ": candle " + std::to_string(i));
+    }
+
+    // Per block, with only some columns requested
+    size_t at = 0;
+    for (size_t b = 0; b < s.block_count(); ++b) {
+        s.decode_block(b, cols, kFieldTime | kFieldClose);
+        check(cols.time_ms.size() == s.block_size(b) && cols.open.empty() && cols.volume.empty(),
+              name + ": partial decode of block " + std::to_string(b));
+        for (size_t j = 0; j < cols.time_ms.size() && at + j < in.size(); ++j) {
+            check(cols.time_ms[j] == in[at + j].time_ms &&
+                  bits_of(cols.close[j]) == bits_of(in[at + j].close),
+                  name + ": block " + std::to_string(b) + " candle " + std::to_string(j));
+        }
+        at += s.block_size(b);
+    }
+}
+
+// Exchange-like 1m series: 2-decimal prices, 4-decimal volumes
+static std::vector<Candle> regular(size_t n, std::mt19937_64& rng) {
+    std::vector<Candle> out;
+    int64_t t = 1704067200000;   // 2024-01-01T00:00:00Z
+    long long cents = 4200000;
+    for (size_t i = 0; i < n; ++i, t += 60000) {
+        const long long o = cents;
+        cents += (long long)(rng() % 201) - 100;
+        const long long h = std::max(o, cents) + (long long)(rng() % 50);
+        const long long l = std::min(o, cents) - (long long)(rng() % 50);
+        out.push_back({ t, o / 100.0, h / 100.0, l / 100.0, cents / 100.0, (double)(rng() % 10000000) / 10000.0 });
+    }
+    return out;
+}
+
+int main() {
+    std::mt19937_64 rng(42);
+
+    // Lengths on and around the block edge
+    for (size_t n : { (size_t)0, (size_t)1, (size_t)2, (size_t)1023, (size_t)1024, (size_t)1025,
+                      (size_t)2048, (size_t)2049, (size_t)5000 })
+        round_trip("regular " + std::to_string(n), regular(n, rng));
+
+    // Special values, including a column that switches between decimal and raw mode
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+    const double specials[] = {
+        nan, -nan, from_bits(0x7ff0000000000001ULL), from_bits(0xfff8dead00000000ULL),
+        0.0, -0.0, inf, -inf, std::numeric_limits<double>::denorm_min(),
+        std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+        0.1, 0.30000000000000004, 1e-9, 123456789.12345678, 9007199254740993.0, 1.0 / 3.0,
+    };
+    const size_t ns = sizeof(specials) / sizeof(specials[0]);
+    {
+        std::vector<Candle> in = regular(3000, rng);
+        for (size_t i = 0; i < in.size(); ++i) {
+            if (i % 7 == 0) in[i].open = specials[i % ns];
+            if (i % 11 == 0) in[i].volume = specials[(i / 11) % ns];
+            if (i % 13 == 0) in[i].close = -0.0;
+            if (i % 1024 == 1023 || i % 1024 == 0) in[i].high = nan;   // around each block edge
+        }
+        round_trip("specials", in);
+    }
+
+    // Irregular, repeated and out-of-order times, and the extremes of int64
+    {
+        std::vector<Candle> in = regular(2100, rng);
+        int64_t t = in[0].time_ms;
+        for (size_t i = 0; i < in.size(); ++i) {
+            switch (rng() % 6) {
+            case 0: t += 1; break;
+            case 1: t += 60000 * (int64_t)(rng() % 500); break;
+            case 2: break;                                   // same time again
+            case 3: t -= (int64_t)(rng() % 100000); break;   // goes back
+            default: t += 60000; break;
+            }
+            in[i].time_ms = t;
+        }
+        in[500].time_ms = std::numeric_limits<int64_t>::min();
+        in[501].time_ms = std::numeric_limits<int64_t>::max();
+        in[502].time_ms = 0;
+        in[1023].time_ms = std::numeric_limits<int64_t>::max();
+        in[1024].time_ms = std::numeric_limits<int64_t>::min();
+        in[1025].time_ms = -1;
+        round_trip("irregular times", in);
+    }
+
+    // Random doubles: every column in raw XOR mode
+    {
+        std::vector<Candle> in(1500);
+        int64_t t = -86400000LL * 365 * 80;   // before 1970
+        for (Candle& c : in) {
+            t += 1000 + (int64_t)(rng() % 5000);
+            c = { t, from_bits(rng()), from_bits(rng()), from_bits(rng()), from_bits(rng()), from_bits(rng()) };
+        }
+        round_trip("random bits", in);
+    }
+
+    // Time parsing and formatting
+    int64_t ms = 0;
+    check(candle_parse_time("2024-01-01T00:00:00Z", ms) && ms == 1704067200000, "parse ISO Z");
+    check(candle_parse_time("2024-01-01 01:30+01:30", ms) && ms == 1704067200000, "parse offset");
+    check(candle_parse_time("2024-02-29T12:34:56.789Z", ms) && candle_format_time(ms) == "2024-02-29T12:34:56.789Z",
+          "parse/format ms");
+    check(candle_parse_time("1704067200000", ms) && candle_format_time(ms) == "2024-01-01T00:00:00Z", "epoch ms");
+    check(candle_parse_time("-1", ms) && candle_format_time(ms) == "1969-12-31T23:59:59.999Z", "negative epoch");
+    check(!candle_parse_time("99999999999999999999", ms), "epoch out of range");
+    check(!candle_parse_time("-99999999999999999999", ms), "negative epoch out of range");
+    check(!candle_parse_time("2024-13-01", ms), "month 13");
+    check(!candle_parse_time("2024-01-01T00:00Zjunk", ms), "trailing junk");
+    check(!candle_parse_time("", ms) && !candle_parse_time("-", ms), "empty");
+
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("candle_store: all round trips exact\n");
+    return 0;
+}
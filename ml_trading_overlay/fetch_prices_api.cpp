@@ -1,8 +1,13 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <map>
 #include <string>
 #include <vector>
+#include <cstdlib>
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
+#include "candle_aggregator.hpp"
 
 using json = nlohmann::json;
 
@@ -11,44 +16,126 @@ static size_t WriteCallback(void* c, size_t s, size_t n, std::string* out) {
     return s*n;
 }
 
-int main() {
+// Binance returns at most this many klines per request
+static const int kPageSize = 1000;
+// Requests per symbol; bounds the history an --interval 1h/1d fetch pulls in
+static const int kMaxPages = 100;
+static const int64_t kMinuteMs = 60000;
+
+static bool fetch_klines(CURL* curl, const std::string& symbol, int64_t start_ms, std::string& buf) {
+    const std::string url = "https://api.binance.com/api/v3/klines?symbol=" + symbol +
+                            "&interval=1m&startTime=" + std::to_string(start_ms) +
+                            "&limit=" + std::to_string(kPageSize);
+    buf.clear();
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buf);
+    auto res = curl_easy_perform(curl);
+    if (res != CURLE_OK) {
+        std::cerr << "curl error: " << curl_easy_strerror(res) << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Usage: fetch_prices_api [--interval 1m|5m|15m|1h|1d] [SYMBOL...]
+//   (default 1m BTCUSDT; KLINES_LIMIT=1..1000 bars of that interval, default 10)
+// Always fetches 1m klines; other intervals are aggregated locally, so one
+// fetch serves every timeframe. The 1m history starts on the first bar's
+// boundary, so every bar is complete except the current one, which is marked
+// as forming. It is paged in requests of 1000 (at most 100 per symbol, which
+// caps 1d at 69 bars).
+int main(int argc, char** argv) {
+    Timeframe interval = Timeframe::M1;
+    std::vector<std::string> symbols;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--interval" && i + 1 < argc) {
+            if (!timeframe_parse(argv[++i], interval)) {
+                std::cerr << "Unknown interval " << argv[i] << " (use 1m, 5m, 15m, 1h or 1d)\n";
+                return 1;
+            }
+        } else {
+            symbols.push_back(a);
+        }
+    }
+    if (symbols.empty()) symbols.push_back("BTCUSDT");
+    int limit = 10;
+    if (const char* env = std::getenv("KLINES_LIMIT")) limit = std::atoi(env);
+    if (limit < 1 || limit > 1000) limit = 10;
+
+    const int64_t bar_ms = timeframe_ms(interval);
+    const int64_t max_bars = std::max<int64_t>(1, (int64_t)kMaxPages * kPageSize * kMinuteMs / bar_ms);
+    if (limit > max_bars) {
+        std::cerr << "KLINES_LIMIT " << limit << " needs more than " << kMaxPages << " requests at "
+                  << timeframe_name(interval) << "; fetching " << max_bars << " bars\n";
+        limit = (int)max_bars;
+    }
+    const int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    const int64_t start_ms = now_ms / bar_ms * bar_ms - (int64_t)(limit - 1) * bar_ms;
+
+    CandleStore store;
     std::string buf;
     curl_global_init(CURL_GLOBAL_DEFAULT);
-    if (auto* curl = curl_easy_init()) {
-        const char* url =
-            "https://api.binance.com/api/v3/klines?symbol=BTCUSDT&interval=1m&limit=10";
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buf);
-        auto res = curl_easy_perform(curl);
-        if (res != CURLE_OK) {
-            std::cerr << "curl error: " << curl_easy_strerror(res) << "\n";
-            curl_easy_cleanup(curl);
-            curl_global_cleanup();
-            return 1;
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        curl_global_cleanup();
+        return 1;
+    }
+
+    for (const std::string& symbol : symbols) {
+        CandleSeries& series = store.series(symbol);
+        int64_t next = start_ms;
+        for (int page = 0; page < kMaxPages && next <= now_ms; ++page) {
+            if (!fetch_klines(curl, symbol, next, buf)) {
+                curl_easy_cleanup(curl);
+                curl_global_cleanup();
+                return 1;
+            }
+
+            auto j = json::parse(buf, nullptr, false);
+            if (j.is_discarded() || !j.is_array()) {
+                std::cerr << symbol << ": bad JSON or not an array\n";
+                break;
+            }
+
+            // Each element is: [openTime, open, high, low, close, volume, closeTime, ...]
+            for (const auto& k : j) {
+                long long openTime = k[0].get<long long>();
+                double open  = std::stod(k[1].get<std::string>());
+                double high  = std::stod(k[2].get<std::string>());
+                double low   = std::stod(k[3].get<std::string>());
+                double close = std::stod(k[4].get<std::string>());
+                double vol   = std::stod(k[5].get<std::string>());
+                series.append({ openTime, open, high, low, close, vol });
+                next = openTime + kMinuteMs;
+            }
+            if (j.size() < (size_t)kPageSize) break;   // caught up with the live minute
         }
-        curl_easy_cleanup(curl);
     }
+    curl_easy_cleanup(curl);
     curl_global_cleanup();
 
-    auto j = json::parse(buf, nullptr, false);
-    if (j.is_discarded() || !j.is_array()) {
-        std::cerr << "bad JSON or not an array\n";
-        return 1;
-    }
+    std::map<std::string, CandleAggregator> higher;
+    if (interval != Timeframe::M1) higher = candle_rebuild(store, { interval });
 
-    // Each element is: [openTime, open, high, low, close, volume, closeTime, ...]
-    for (const auto& k : j) {
-        long long openTime = k[0].get<long long>();
-        double open  = std::stod(k[1].get<std::string>());
-        double high  = std::stod(k[2].get<std::string>());
-        double low   = std::stod(k[3].get<std::string>());
-        double close = std::stod(k[4].get<std::string>());
-        double vol   = std::stod(k[5].get<std::string>());
-
-        std::cout << openTime << " O:" << open
-                  << " H:" << high << " L:" << low
-                  << " C:" << close << " V:" << vol << "\n";
+    CandleColumns cols;
+    for (const auto& s : store.all()) {
+        if (interval == Timeframe::M1) s.second.decode_all(cols);
+        else higher.at(s.first).bars(interval, cols);
+        for (size_t i = 0; i < cols.time_ms.size(); ++i) {
+            std::cout << s.first << " " << cols.time_ms[i] << " O:" << cols.open[i]
+                      << " H:" << cols.high[i] << " L:" << cols.low[i]
+                      << " C:" << cols.close[i] << " V:" << cols.volume[i]
+                      << (cols.time_ms[i] + bar_ms > now_ms ? " (forming)" : "") << "\n";
+        }
     }
+
+    size_t n = store.candles(), packed = store.compressed_bytes();
+    std::cout << "Stored " << n << " 1m candles for " << store.all().size() << " symbol(s) in "
+              << packed << " bytes (" << store.raw_bytes() << " uncompressed";
+    if (n) std::cout << ", " << (packed * 8.0 / n) << " bits/candle";
+    std::cout << ")\n";
     return 0;
 }
@@ -5,8 +5,7 @@
 #include <vector>
 #include <string>
 #include <cmath>
-
-struct Row { std::string time_iso; double open, high, low, close, volume; };
+#include "candle_aggregator.hpp"
 
 static std::vector<double> ema(const std::vector<double>& x, int n) {
     std::vector<double> e(x.size(), 0.0);
@@ -36,50 +35,93 @@ static std::vector<double> rsi14(const std::vector<double>& c) {
     return r;
 }
 
-static bool parse_csv_row(const std::string& line, Row& out) {
-    // Expect: time_iso,open,high,low,close,volume  (header allowed)
+// false with `why` set: a data row that had to be dropped; false with `why` empty: a header
+static bool parse_csv_row(const std::string& line, Candle& out, std::string& why) {
+    // Expect: time,open,high,low,close,volume  (header allowed; time is ISO-8601 or epoch ms)
+    why.clear();
     std::stringstream ss(line);
     std::string tok;
     std::vector<std::string> t;
     while (std::getline(ss, tok, ',')) t.push_back(tok);
-    if (t.size()<6) return false;
+    if (t.size()<6){ why = "expected 6 columns"; return false; }
     // skip header
     if (!std::isdigit(t[1].empty()? 'x' : t[1][0]) && t[1]!="0") return false;
-    out.time_iso = t[0];
-    out.open  = std::stod(t[1]);
-    out.high  = std::stod(t[2]);
-    out.low   = std::stod(t[3]);
-    out.close = std::stod(t[4]);
-    out.volume= std::stod(t[5]);
+    if (!candle_parse_time(t[0], out.time_ms)){ why = "unparsed time '" + t[0] + "'"; return false; }
+    try {
+        out.open  = std::stod(t[1]);
+        out.high  = std::stod(t[2]);
+        out.low   = std::stod(t[3]);
+        out.close = std::stod(t[4]);
+        out.volume= std::stod(t[5]);
+    } catch (const std::exception&) {
+        why = "unparsed number";
+        return false;
+    }
     return true;
 }
 
 int main(int argc, char** argv){
     if (argc<3){
-        std::cerr << "Usage: " << argv[0] << " <input_raw_ohlcv.csv> <output_features.csv>\n";
-        std::cerr << "Expected input columns: time_iso,open,high,low,close,volume\n";
+        std::cerr << "Usage: " << argv[0] << " <input_raw_ohlcv.csv> <output_features.csv> [timeframe]\n";
+        std::cerr << "Expected input columns: time,open,high,low,close,volume (time as ISO-8601 or epoch ms)\n";
+        std::cerr << "timeframe (5m, 15m, 1h, 1d) aggregates the input candles into bars of that size first;\n"
+                     "  only complete bars are written\n";
+        std::cerr << "Output time_iso is normalized to UTC (YYYY-MM-DDTHH:MM:SSZ, the bar's open time when\n"
+                     "aggregating) whatever the input's format or offset; rows whose time or numbers do not\n"
+                     "parse are skipped and reported\n";
         return 1;
     }
     const std::string inpath=argv[1], outpath=argv[2];
+    Timeframe tf = Timeframe::M1;
+    const bool aggregate = argc>3;
+    if (aggregate && !timeframe_parse(argv[3], tf)){ std::cerr<<"Unknown timeframe "<<argv[3]<<"\n"; return 1; }
 
     std::ifstream in(inpath);
     if(!in){ std::cerr<<"Cannot open "<<inpath<<"\n"; return 1; }
 
     std::string line;
-    std::vector<Row> rows; rows.reserve(2000);
+    CandleSeries input;
+    CandleAggregator agg({ tf });
 
-    // try to read header
-    if (std::getline(in,line)) {
-        Row r;
-        if (parse_csv_row(line,r)) rows.push_back(r); // if first line was data, keep it
-    }
+    // The first line may be a header or data; later non-data lines are reported
+    size_t lineno = 0, rejected = 0;
+    std::string why;
     while (std::getline(in,line)){
-        Row r; if(parse_csv_row(line,r)) rows.push_back(r);
+        ++lineno;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        Candle r;
+        if (!parse_csv_row(line,r,why)){
+            if (why.empty() && lineno==1) continue;   // header
+            if (why.empty()) why = "not a data row";
+            if (++rejected <= 10) std::cerr << inpath << ":" << lineno << ": skipped, " << why << "\n";
+            continue;
+        }
+        if (aggregate) agg.push(r); else input.append(r);
+    }
+    if (rejected) std::cerr << "Skipped " << rejected << " of " << lineno << " lines\n";
+
+    // aggregated: complete bars only. A first bar the input joins mid-bucket lacks its
+    // real open, and a last bar the input stops short of would still change.
+    CandleSeries bars;
+    if (aggregate) {
+        bars = agg.closed(tf);
+        Candle last;
+        bool complete = false;
+        if (agg.forming(tf, last, &complete)) {
+            if (complete) bars.append(last);
+            else std::cerr << "Left out the incomplete last " << timeframe_name(tf) << " bar ("
+                           << candle_format_time(last.time_ms) << ")\n";
+        }
+        if (agg.dropped_leading(tf))
+            std::cerr << "Left out the first " << timeframe_name(tf) << " bar: the input starts mid-bar\n";
     }
+    const CandleSeries& rows = aggregate ? bars : input;
     if (rows.size()<20){ std::cerr<<"Not enough rows.\n"; return 1; }
 
-    std::vector<double> closes; closes.reserve(rows.size());
-    for (auto& r: rows) closes.push_back(r.close);
+    // indicators only need the close column
+    CandleColumns cols;
+    rows.decode_all(cols, kFieldClose);
+    const std::vector<double> closes = std::move(cols.close);
 
     // features
     std::vector<double> ret(rows.size(), NAN);
@@ -90,19 +132,27 @@ int main(int argc, char** argv){
 
     std::ofstream out(outpath);
     if(!out){ std::cerr<<"Cannot open "<<outpath<<"\n"; return 1; }
+    // time_iso is written as UTC (candle_format_time), not echoed from the input
     out << "time_iso,open,high,low,close,volume,return,ema20,ema50,rsi14\n";
-    for (size_t i=0;i<rows.size();++i){
-        out << rows[i].time_iso << ","
-            << rows[i].open << ","
-            << rows[i].high << ","
-            << rows[i].low  << ","
-            << rows[i].close<< ","
-            << rows[i].volume<< ","
-            << (std::isnan(ret[i])?0.0:ret[i]) << ","
-            << ema20[i] << ","
-            << ema50[i] << ","
-            << (std::isnan(rsi[i])?0.0:rsi[i]) << "\n";
+    // decode one block at a time into the same scratch columns
+    size_t i=0;
+    for (size_t b=0;b<rows.block_count();++b){
+        rows.decode_block(b, cols);
+        for (size_t j=0;j<cols.time_ms.size();++j,++i){
+            out << candle_format_time(cols.time_ms[j]) << ","
+                << cols.open[j] << ","
+                << cols.high[j] << ","
+                << cols.low[j]  << ","
+                << cols.close[j]<< ","
+                << cols.volume[j]<< ","
+                << (std::isnan(ret[i])?0.0:ret[i]) << ","
+                << ema20[i] << ","
+                << ema50[i] << ","
+                << (std::isnan(rsi[i])?0.0:rsi[i]) << "\n";
+        }
     }
     std::cout << "Wrote features to " << outpath << "\n";
+    std::cout << rows.size() << " candles held in " << rows.compressed_bytes()
+              << " bytes (" << rows.raw_bytes() << " uncompressed)\n";
     return 0;
 }
@@ -0,0 +1,105 @@
+#include "nine_slice.hpp"
+#include "layer_cache.hpp"
+#include "rsvg_render.hpp"
+#include "surface_pool.hpp"
+#include <cairo.h>
+#include <algorithm>
+
+std::string nineSlicePathFor(const std::string& svg_path) {
+    const std::string ext = ".svg";
+    if (svg_path.size() >= ext.size() &&
+        svg_path.compare(svg_path.size() - ext.size(), ext.size(), ext) == 0)
+        return svg_path.substr(0, svg_path.size() - ext.size()) + ".9.svg";
+    return svg_path + ".9.svg";
+}
+
+NineSlice nine_slice_load(const std::string& svg_path, int ref_width, int ref_height,
+                          const NineSliceInsets& insets) {
+    NineSlice ns;
+    ns.insets = insets;
+    ns.source = layer_cache_get(
+        { svg_path, "", ref_width, ref_height },
+        [svg_path](int w, int h) { return renderSvgToSurface(svg_path, w, h); });
+    return ns;
+}
+
+// Shrink a pair of opposing insets so they fit in `avail` pixels
+static void fit_insets(int& a, int& b, int avail) {
+    if (a + b <= avail) return;
+    const int total = a + b;
+    a = total > 0 ? a * avail / total : 0;
+    b = avail - a;
+}
+
+// Paint src rect (sx,sy,sw,sh) of `src` into dst rect (dx,dy,dw,dh)
+static void draw_slice(cairo_t* cr, cairo_surface_t* src,
+                       int sx, int sy, int sw, int sh,
+                       int dx, int dy, int dw, int dh, NineSliceFill fill) {
+    if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0) return;
+
+    // Subsurface keeps sampling (and tiling) inside the slice, so neighbours never bleed in
+    cairo_surface_t* slice = cairo_surface_create_for_rectangle(src, sx, sy, sw, sh);
+
+    cairo_save(cr);
+    cairo_rectangle(cr, dx, dy, dw, dh);
+    cairo_clip(cr);
+    cairo_translate(cr, dx, dy);
+
+    const bool stretch = fill == NineSliceFill::Stretch && (sw != dw || sh != dh);
+    if (stretch) cairo_scale(cr, (double)dw / sw, (double)dh / sh);
+
+    cairo_set_source_surface(cr, slice, 0, 0);
+    cairo_pattern_t* pat = cairo_get_source(cr);
+    cairo_pattern_set_extend(pat, stretch ? CAIRO_EXTEND_PAD : CAIRO_EXTEND_REPEAT);
+    cairo_pattern_set_filter(pat, stretch ? CAIRO_FILTER_BILINEAR : CAIRO_FILTER_NEAREST);
+    cairo_paint(cr);
+
+    cairo_restore(cr);
+    cairo_surface_destroy(slice);
+}
+
+cairo_surface_t* nine_slice_compose(const NineSlice& ns, int width, int height, NineSliceFill fill) {
+    if (!ns.source || width <= 0 || height <= 0) return nullptr;
+
+    const int SW = cairo_image_surface_get_width(ns.source);
+    const int SH = cairo_image_surface_get_height(ns.source);
+
+    // Source slice edges
+    int sl = std::clamp(ns.insets.left,   0, SW), sr = std::clamp(ns.insets.right,  0, SW - sl);
+    int st = std::clamp(ns.insets.top,    0, SH), sb = std::clamp(ns.insets.bottom, 0, SH - st);
+
+    // Destination corners keep their size unless the target is smaller than both together
+    int dl = sl, dr = sr, dt = st, db = sb;
+    fit_insets(dl, dr, width);
+    fit_insets(dt, db, height);
+
+    const int src_cols[3] = { 0, sl, SW - sr };
+    const int src_w[3]    = { sl, SW - sl - sr, sr };
+    const int src_rows[3] = { 0, st, SH - sb };
+    const int src_h[3]    = { st, SH - st - sb, sb };
+
+    const int dst_cols[3] = { 0, dl, width - dr };
+    const int dst_w[3]    = { dl, width - dl - dr, dr };
+    const int dst_rows[3] = { 0, dt, height - db };
+    const int dst_h[3]    = { dt, height - dt - db, db };
+
+    cairo_surface_t* out = surface_pool_acquire(width, height);
+    cairo_t* cr = cairo_create(out);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 3; ++col) {
+            draw_slice(cr, ns.source,
+                       src_cols[col], src_rows[row], src_w[col], src_h[row],
+                       dst_cols[col], dst_rows[row], dst_w[col], dst_h[row], fill);
+        }
+    }
+
+    cairo_destroy(cr);
+    return out;
+}
+
+void nine_slice_free(NineSlice& ns) {
+    if (ns.source) cairo_surface_destroy(ns.source);
+    ns.source = nullptr;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <cairo.h>
+
+// Border thickness of a nine-slice asset, in pixels of its reference raster
+struct NineSliceInsets {
+    int left   = 0;
+    int top    = 0;
+    int right  = 0;
+    int bottom = 0;
+};
+
+// How edges and the center fill the space between the corners
+enum class NineSliceFill { Stretch, Tile };
+
+// A border asset rasterized once at its reference size
+struct NineSlice {
+    cairo_surface_t* source = nullptr;
+    NineSliceInsets insets;
+};
+
+// Nine-slice variant of a border SVG: "border/blue.svg" -> "border/blue.9.svg"
+std::string nineSlicePathFor(const std::string& svg_path);
+
+// Rasterize the SVG once at ref_width x ref_height (shared through the layer cache).
+// source is nullptr if the SVG could not be rendered.
+NineSlice nine_slice_load(const std::string& svg_path, int ref_width, int ref_height,
+                          const NineSliceInsets& insets);
+
+// Compose corners 1:1 and edges/center stretched or tiled into a new width x height surface.
+cairo_surface_t* nine_slice_compose(const NineSlice& ns, int width, int height,
+                                    NineSliceFill fill = NineSliceFill::Stretch);
+
+void nine_slice_free(NineSlice& ns);
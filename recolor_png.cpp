@@ -1,22 +1,151 @@
 #include <librsvg/rsvg.h>
 #include "recolor_png.hpp"
+#include "color_math.hpp"
+#include "trace.hpp"
+#include "surface_pool.hpp"
 #include <cairo/cairo.h>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
+static cairo_surface_t* load_png(const char* path) {
+    TRACE_SCOPE("png.decode");
+    cairo_surface_t* s = cairo_image_surface_create_from_png(path);
+    TRACE_BYTES((uint64_t)cairo_image_surface_get_stride(s) * cairo_image_surface_get_height(s));
+    return s;
+}
 
-// parse "#RRGGBB" or "#RRGGBBAA" (alpha optional)
-static bool parse_hex_rgba(const std::string& hex, double& r,double& g,double& b,double& a){
-    if (hex.empty() || hex[0] != '#') return false;
-    unsigned rv=0,gv=0,bv=0,av=255;
-    if (hex.size()==7)       { if (sscanf(hex.c_str()+1,"%02x%02x%02x",&rv,&gv,&bv)!=3) return false; }
-    else if (hex.size()==9 ) { if (sscanf(hex.c_str()+1,"%02x%02x%02x%02x",&rv,&gv,&bv,&av)!=4) return false; }
-    else return false;
-    r=rv/255.0; g=gv/255.0; b=bv/255.0; a=av/255.0; return true;
+static void write_png(cairo_surface_t* s, const char* path) {
+    TRACE_SCOPE("png.encode");
+    TRACE_BYTES((uint64_t)cairo_image_surface_get_stride(s) * cairo_image_surface_get_height(s));
+    cairo_surface_write_to_png(s, path);
 }
 
+// ---- Fused 8-bit kernels ----
+// Both filters used to go through cairo's general compositor in several passes.
+// These kernels read each source pixel once and write once, reproducing pixman's
+// integer math exactly so the output is bit-identical (see --verify in main).
 
-static void tint_png_multiply(const char* in_png, const char* out_png,
-                              double r, double g, double b, double a = 1.0) {
-    cairo_surface_t* src = cairo_image_surface_create_from_png(in_png);
+// cairo_set_source_rgba -> pixman solid: every channel is clamped to [0, 1] first,
+// then goes through a 16-bit premultiplied short, (c * a * 65535 + 0.5), and
+// pixman keeps the top byte.
+static uint32_t solid_premultiplied(double r, double g, double b, double a) {
+    auto clamp01 = [](double v) { return v < 0.0 ? 0.0 : (v > 1.0 ? 1.0 : v); };
+    auto to8 = [](double v) { return (uint32_t)((uint16_t)(v * 65535.0 + 0.5) >> 8); };
+    r = clamp01(r); g = clamp01(g); b = clamp01(b); a = clamp01(a);
+    return (to8(a) << 24) | (to8(r * a) << 16) | (to8(g * a) << 8) | to8(b * a);
+}
+
+// pixman MUL_UN8: x * a / 255, rounded
+static inline uint32_t mul_un8(uint32_t x, uint32_t a) {
+    uint32_t t = x * a + 0x80;
+    return (t + (t >> 8)) >> 8;
+}
+
+static inline uint32_t mul_un8x4(uint32_t x, uint32_t a) {
+    return mul_un8(x & 0xff, a) | mul_un8((x >> 8) & 0xff, a) << 8 |
+           mul_un8((x >> 16) & 0xff, a) << 16 | mul_un8(x >> 24, a) << 24;
+}
+
+// RGB24 PNGs (no alpha channel) leave the top byte undefined; cairo reads them as opaque
+static inline uint32_t opaque_if(uint32_t p, uint32_t alpha_fill) { return p | alpha_fill; }
+
+// OVER-into-cleared / SOURCE with a solid source and the pixel's alpha as mask:
+// out = solid * m. This is cairo_mask_surface onto a cleared surface.
+static uint32_t mask_solid_pixel(uint32_t p, uint32_t solid) {
+    return mul_un8x4(solid, p >> 24);
+}
+
+// pixman combine_multiply_u with mask: s = solid * m, d = p
+//   out = d*s + s*(1 - da) + d*(1 - sa)      (per channel, saturating)
+static uint32_t tint_multiply_pixel(uint32_t p, uint32_t solid) {
+    const uint32_t s = mul_un8x4(solid, p >> 24);
+    const uint32_t s_ia = 255 - (s >> 24), d_ia = 255 - (p >> 24);
+    uint32_t out = 0;
+    for (int sh = 0; sh < 32; sh += 8) {
+        const uint32_t sc = (s >> sh) & 0xff, dc = (p >> sh) & 0xff;
+        uint32_t v = mul_un8(sc, d_ia) + mul_un8(dc, s_ia);
+        v = (v > 255 ? 255 : v) + mul_un8(dc, sc);
+        out |= (v > 255 ? 255 : v) << sh;
+    }
+    return out;
+}
+
+#if defined(__SSE2__)
+// 16-bit-lane MUL_UN8 on 8 channels (2 pixels): mulhi by 0x0101 is pixman's exact
+// (t + (t >> 8)) >> 8
+static inline __m128i mul_un8_epi16(__m128i x, __m128i a) {
+    const __m128i t = _mm_adds_epu16(_mm_mullo_epi16(x, a), _mm_set1_epi16(0x80));
+    return _mm_mulhi_epu16(t, _mm_set1_epi16(0x0101));
+}
+
+static inline __m128i alpha_epi16(__m128i x) {
+    x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_shufflehi_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// Per 2 pixels in 16-bit lanes
+static inline __m128i tint_multiply_epi16(__m128i d, __m128i solid) {
+    const __m128i ff = _mm_set1_epi16(0xff);
+    const __m128i s = mul_un8_epi16(solid, alpha_epi16(d));
+    const __m128i ss = _mm_min_epi16(_mm_add_epi16(mul_un8_epi16(s, _mm_sub_epi16(ff, alpha_epi16(d))),
+                                                   mul_un8_epi16(d, _mm_sub_epi16(ff, alpha_epi16(s)))), ff);
+    return _mm_add_epi16(mul_un8_epi16(d, s), ss);  // packus saturates to 255
+}
+#endif
+
+enum class FusedOp { TintMultiply, MaskSolid };
+
+static void fused_row(const uint32_t* src, uint32_t* dst, int n, uint32_t solid, uint32_t alpha_fill, FusedOp op) {
+    int x = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i fill = _mm_set1_epi32((int)alpha_fill);
+    const __m128i solid16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)solid), zero);
+    for (; x + 4 <= n; x += 4) {
+        const __m128i p = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)), fill);
+        const __m128i lo = _mm_unpacklo_epi8(p, zero), hi = _mm_unpackhi_epi8(p, zero);
+        __m128i rlo, rhi;
+        if (op == FusedOp::TintMultiply) {
+            rlo = tint_multiply_epi16(lo, solid16);
+            rhi = tint_multiply_epi16(hi, solid16);
+        } else {
+            rlo = mul_un8_epi16(solid16, alpha_epi16(lo));
+            rhi = mul_un8_epi16(solid16, alpha_epi16(hi));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(rlo, rhi));
+    }
+#endif
+    for (; x < n; ++x) {
+        const uint32_t p = opaque_if(src[x], alpha_fill);
+        dst[x] = op == FusedOp::TintMultiply ? tint_multiply_pixel(p, solid) : mask_solid_pixel(p, solid);
+    }
+}
+
+// One pass over `src` into a new pooled surface
+static cairo_surface_t* fused_apply(cairo_surface_t* src, uint32_t solid, FusedOp op) {
+    cairo_surface_flush(src);
+    const int W = cairo_image_surface_get_width(src);
+    const int H = cairo_image_surface_get_height(src);
+    const uint32_t alpha_fill = cairo_image_surface_get_format(src) == CAIRO_FORMAT_ARGB32 ? 0 : 0xff000000u;
+    const unsigned char* sdata = cairo_image_surface_get_data(src);
+    const int sstride = cairo_image_surface_get_stride(src);
+
+    cairo_surface_t* dst = surface_pool_acquire(W, H, false);  // every pixel is written
+    unsigned char* ddata = cairo_image_surface_get_data(dst);
+    const int dstride = cairo_image_surface_get_stride(dst);
+    for (int y = 0; y < H; ++y)
+        fused_row(reinterpret_cast<const uint32_t*>(sdata + (size_t)y * sstride),
+                  reinterpret_cast<uint32_t*>(ddata + (size_t)y * dstride), W, solid, alpha_fill, op);
+    cairo_surface_mark_dirty(dst);
+    return dst;
+}
+
+// ---- Reference cairo paths (kept for --verify) ----
+static cairo_surface_t* tint_multiply_cairo(cairo_surface_t* src, double r, double g, double b, double a) {
     int W = cairo_image_surface_get_width(src);
     int H = cairo_image_surface_get_height(src);
 
@@ -33,15 +162,11 @@ static void tint_png_multiply(const char* in_png, const char* out_png,
     cairo_set_source_rgba(cr, r, g, b, a);
     cairo_mask_surface(cr, src, 0, 0); // use PNG’s alpha as mask
 
-    cairo_surface_write_to_png(dst, out_png);
     cairo_destroy(cr);
-    cairo_surface_destroy(dst);
-    cairo_surface_destroy(src);
+    return dst;
 }
 
-static void recolor_png_with_alpha_mask(const char* in_png, const char* out_png,
-                                        double r, double g, double b, double a = 1.0) {
-    cairo_surface_t* mask = cairo_image_surface_create_from_png(in_png);
+static cairo_surface_t* recolor_alpha_mask_cairo(cairo_surface_t* mask, double r, double g, double b, double a) {
     int W = cairo_image_surface_get_width(mask);
     int H = cairo_image_surface_get_height(mask);
 
@@ -57,78 +182,130 @@ static void recolor_png_with_alpha_mask(const char* in_png, const char* out_png,
     cairo_set_source_rgba(cr, r, g, b, a);
     cairo_mask_surface(cr, mask, 0, 0);
 
-    cairo_surface_write_to_png(dst, out_png);
     cairo_destroy(cr);
+    return dst;
+}
+
+void tint_png_multiply(const char* in_png, const char* out_png,
+                       double r, double g, double b, double a) {
+    TRACE_SCOPE("recolor.tint");
+    cairo_surface_t* src = load_png(in_png);
+    if (cairo_surface_status(src) != CAIRO_STATUS_SUCCESS) {
+        std::cerr << "Failed to load PNG: " << in_png << "\n";
+        cairo_surface_destroy(src);
+        return;
+    }
+    TRACE_BYTES((uint64_t)cairo_image_surface_get_width(src) * cairo_image_surface_get_height(src) * 4);
+
+    cairo_surface_t* dst = fused_apply(src, solid_premultiplied(r, g, b, a), FusedOp::TintMultiply);
+    write_png(dst, out_png);
+    cairo_surface_destroy(dst);
+    cairo_surface_destroy(src);
+}
+
+void recolor_png_with_alpha_mask(const char* in_png, const char* out_png,
+                                 double r, double g, double b, double a) {
+    TRACE_SCOPE("recolor.alpha_mask");
+    cairo_surface_t* mask = load_png(in_png);
+    if (cairo_surface_status(mask) != CAIRO_STATUS_SUCCESS) {
+        std::cerr << "Failed to load PNG: " << in_png << "\n";
+        cairo_surface_destroy(mask);
+        return;
+    }
+    TRACE_BYTES((uint64_t)cairo_image_surface_get_width(mask) * cairo_image_surface_get_height(mask) * 4);
+
+    cairo_surface_t* dst = fused_apply(mask, solid_premultiplied(r, g, b, a), FusedOp::MaskSolid);
+    write_png(dst, out_png);
     cairo_surface_destroy(dst);
     cairo_surface_destroy(mask);
 }
 
+// Count pixels where the fused kernel and the cairo path disagree
+static size_t count_mismatches(cairo_surface_t* x, cairo_surface_t* y) {
+    cairo_surface_flush(x);
+    cairo_surface_flush(y);
+    const int W = cairo_image_surface_get_width(x), H = cairo_image_surface_get_height(x);
+    size_t bad = 0;
+    for (int row = 0; row < H; ++row) {
+        const uint32_t* a = reinterpret_cast<const uint32_t*>(cairo_image_surface_get_data(x) + (size_t)row * cairo_image_surface_get_stride(x));
+        const uint32_t* b = reinterpret_cast<const uint32_t*>(cairo_image_surface_get_data(y) + (size_t)row * cairo_image_surface_get_stride(y));
+        for (int i = 0; i < W; ++i) bad += a[i] != b[i];
+    }
+    return bad;
+}
+
+bool recolor_verify_fused(const char* in_png) {
+    cairo_surface_t* src = cairo_image_surface_create_from_png(in_png);
+    if (cairo_surface_status(src) != CAIRO_STATUS_SUCCESS) {
+        std::cerr << "Failed to load PNG: " << in_png << "\n";
+        cairo_surface_destroy(src);
+        return false;
+    }
+
+    // Colours that hit rounding edges: opaque, translucent, black, white, odd fractions,
+    // and out-of-range channels (cairo clamps each before premultiplying)
+    const double colors[][4] = {
+        { 0.9, 0.25, 0.2, 1.0 }, { 0.2, 0.55, 0.9, 1.0 }, { 1, 1, 1, 1 }, { 0, 0, 0, 1 },
+        { 0.5, 0.5, 0.5, 0.5 }, { 0.3, 0.7, 0.1, 0.33 }, { 1, 0, 0.5, 0.01 }, { 0.1, 0.2, 0.3, 0.0 },
+        { 1.5, -0.2, 0.5, 0.5 }, { 0.4, 2.0, 0.1, 1.7 }, { -1, 0.6, 3, -0.5 },
+    };
+    bool ok = true;
+    for (const auto& c : colors) {
+        const uint32_t solid = solid_premultiplied(c[0], c[1], c[2], c[3]);
+
+        cairo_surface_t* ref = tint_multiply_cairo(src, c[0], c[1], c[2], c[3]);
+        cairo_surface_t* fused = fused_apply(src, solid, FusedOp::TintMultiply);
+        size_t bad_tint = count_mismatches(ref, fused);
+        cairo_surface_destroy(ref);
+        cairo_surface_destroy(fused);
+
+        ref = recolor_alpha_mask_cairo(src, c[0], c[1], c[2], c[3]);
+        fused = fused_apply(src, solid, FusedOp::MaskSolid);
+        size_t bad_mask = count_mismatches(ref, fused);
+        cairo_surface_destroy(ref);
+        cairo_surface_destroy(fused);
+
+        std::cout << "rgba(" << c[0] << "," << c[1] << "," << c[2] << "," << c[3] << "): tint "
+                  << bad_tint << " mismatched px, recolor " << bad_mask << " mismatched px\n";
+        ok = ok && bad_tint == 0 && bad_mask == 0;
+    }
+    cairo_surface_destroy(src);
+    std::cout << (ok ? "fused kernels match cairo\n" : "fused kernels DIFFER from cairo\n");
+    return ok;
+}
+
 
 #include <cstdint>
 #include <cmath>
 
-static inline void rgb_to_hsv(double R, double G, double B, double& h, double& s, double& v){
-    double mx = std::fmax(R, std::fmax(G, B));
-    double mn = std::fmin(R, std::fmin(G, B));
-    v = mx; double d = mx - mn; s = (mx == 0 ? 0 : d / mx);
-    if (d == 0) { h = 0; return; }
-    if (mx == R) h = 60.0 * std::fmod(((G - B) / d), 6.0);
-    else if (mx == G) h = 60.0 * (((B - R) / d) + 2.0);
-    else h = 60.0 * (((R - G) / d) + 4.0);
-    if (h < 0) h += 360.0;
-}
-static inline void hsv_to_rgb(double h, double s, double v, double& R, double& G, double& B){
-    double C = v * s;
-    double X = C * (1 - std::fabs(std::fmod(h/60.0, 2) - 1));
-    double m = v - C;
-    double r=0,g=0,b=0;
-    if (h < 60)      { r=C; g=X; b=0; }
-    else if (h<120 ) { r=X; g=C; b=0; }
-    else if (h<180 ) { r=0; g=C; b=X; }
-    else if (h<240 ) { r=0; g=X; b=C; }
-    else if (h<300 ) { r=X; g=0; b=C; }
-    else             { r=C; g=0; b=X; }
-    R=r+m; G=g+m; B=b+m;
-}
-
-static void hue_shift_png(const char* in_png, const char* out_png, double hue_delta_deg){
-    cairo_surface_t* s = cairo_image_surface_create_from_png(in_png);
+void hue_shift_png(const char* in_png, const char* out_png, double hue_delta_deg){
+    TRACE_SCOPE("recolor.hue_shift");
+    cairo_surface_t* s = load_png(in_png);
     cairo_surface_flush(s);
 
     int W = cairo_image_surface_get_width(s);
     int H = cairo_image_surface_get_height(s);
+    TRACE_BYTES((uint64_t)W * H * 4);
     uint8_t* data = cairo_image_surface_get_data(s);
     int stride = cairo_image_surface_get_stride(s);
 
+    // One row at a time through the batched colour module:
+    // unpremultiply -> HSV -> shift -> RGB -> premultiply
+    std::vector<float> r(W), g(W), b(W), a(W);
+    const float delta = (float)std::fmod(std::fmod(hue_delta_deg, 360.0) + 360.0, 360.0);
     for (int y=0; y<H; ++y){
         uint32_t* row = reinterpret_cast<uint32_t*>(data + y*stride);
+        unpremultiply_argb32(row, r.data(), g.data(), b.data(), a.data(), W);
+        rgb_to_hsv_batch(r.data(), g.data(), b.data(), r.data(), g.data(), b.data(), W);
         for (int x=0; x<W; ++x){
-            uint32_t p = row[x];
-            uint8_t a = (p >> 24) & 0xFF, r = (p >> 16) & 0xFF, g = (p >> 8) & 0xFF, b = p & 0xFF;
-            if (a == 0) continue; // fully transparent
-
-            // Un-premultiply
-            double R = r/255.0, G = g/255.0, B = b/255.0, A = a/255.0;
-            if (A > 0) { R /= A; G /= A; B /= A; }
-
-            // Shift hue
-            double h,s,v; rgb_to_hsv(R,G,B,h,s,v);
-            h = std::fmod(h + hue_delta_deg + 360.0, 360.0);
-            hsv_to_rgb(h,s,v,R,G,B);
-
-            // Re-premultiply
-            R = std::min(std::max(R,0.0),1.0);
-            G = std::min(std::max(G,0.0),1.0);
-            B = std::min(std::max(B,0.0),1.0);
-            uint8_t R8 = (uint8_t)std::round(R * A * 255.0);
-            uint8_t G8 = (uint8_t)std::round(G * A * 255.0);
-            uint8_t B8 = (uint8_t)std::round(B * A * 255.0);
-
-            row[x] = (a<<24) | (R8<<16) | (G8<<8) | (B8);
+            float h = r[x] + delta;
+            r[x] = h >= 360.0f ? h - 360.0f : h;
         }
+        hsv_to_rgb_batch(r.data(), g.data(), b.data(), r.data(), g.data(), b.data(), W);
+        premultiply_argb32(r.data(), g.data(), b.data(), a.data(), row, W);
     }
     cairo_surface_mark_dirty(s);
-    cairo_surface_write_to_png(s, out_png);
+    write_png(s, out_png);
     cairo_surface_destroy(s);
 }
 
@@ -136,10 +313,17 @@ static void hue_shift_png(const char* in_png, const char* out_png, double hue_de
 #include <algorithm> // add this
 #include <iostream>
 
-int main() {
+// Built into render_daemon with -DRENDER_TOOL_NO_MAIN
+#ifndef RENDER_TOOL_NO_MAIN
+int main(int argc, char** argv) {
+    // recolor_png --verify <in.png>: check the fused kernels against cairo bit for bit
+    if (argc > 2 && std::string(argv[1]) == "--verify")
+        return recolor_verify_fused(argv[2]) ? 0 : 1;
+
     tint_png_multiply("in.png", "mul.png", 0.9, 0.25, 0.2, 1.0);
     recolor_png_with_alpha_mask("in.png", "flat.png", 0.2, 0.55, 0.9, 1.0);
     hue_shift_png("in.png", "hue.png", 40.0);
     std::cout << "done\n";
     return 0;
 }
+#endif
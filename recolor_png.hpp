@@ -1,7 +1,7 @@
 #pragma once
+#include <string>
 #include <cairo/cairo.h>
-
-bool parse_hex_rgba(const std::string& hex, double& r,double& g,double& b,double& a);
+#include "color_math.hpp"
 
 void tint_png_multiply(const char* in_png, const char* out_png,
                               double r, double g, double b, double a = 1.0);
@@ -9,10 +9,8 @@ void tint_png_multiply(const char* in_png, const char* out_png,
 void recolor_png_with_alpha_mask(const char* in_png, const char* out_png,
                                         double r, double g, double b, double a = 1.0);
 
-void rgb_to_hsv(double R, double G, double B, double& h, double& s, double& v);
-
-void hsv_to_rgb(double h, double s, double v, double& R, double& G, double& B);
-
 void hue_shift_png(const char* in_png, const char* out_png, double hue_delta_deg);
 
-main(); 
\ No newline at end of file
+// Run tint/recolor through both the fused kernels and the original cairo
+// compositing for a set of colours; prints mismatch counts, true if all identical.
+bool recolor_verify_fused(const char* in_png);
@@ -0,0 +1,58 @@
+// Fused tint/recolor kernels against cairo's own compositing, bit for bit, on
+// synthetic inputs that cover every alpha value (ARGB32) and an opaque RGB24 PNG.
+// Build: g++ -O2 -std=c++17 -DRENDER_TOOL_NO_MAIN recolor_png_test.cpp recolor_png.cpp color_math.cpp
+//        surface_pool.cpp trace.cpp $(pkg-config --cflags --libs cairo librsvg-2.0) -pthread -o recolor_png_test
+#include "recolor_png.hpp"
+#include <cairo.h>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// 256x256: alpha runs along x, colour along y (kept <= alpha, as premultiplied
+// pixels must be), with the channels offset so they differ from each other
+static bool write_input(const std::string& path, cairo_format_t format) {
+    cairo_surface_t* s = cairo_image_surface_create(format, 256, 256);
+    cairo_surface_flush(s);
+    unsigned char* data = cairo_image_surface_get_data(s);
+    const int stride = cairo_image_surface_get_stride(s);
+    for (int y = 0; y < 256; ++y) {
+        uint32_t* row = reinterpret_cast<uint32_t*>(data + (size_t)y * stride);
+        for (int x = 0; x < 256; ++x) {
+            const uint32_t a = format == CAIRO_FORMAT_ARGB32 ? (uint32_t)x : 255u;
+            auto c = [&](int k) { return a ? (uint32_t)((y * 7 + x * 3 + k * 85) % 256) * a / 255 : 0u; };
+            row[x] = (a << 24) | (c(0) << 16) | (c(1) << 8) | c(2);
+        }
+    }
+    cairo_surface_mark_dirty(s);
+    const bool ok = cairo_surface_write_to_png(s, path.c_str()) == CAIRO_STATUS_SUCCESS;
+    cairo_surface_destroy(s);
+    return ok;
+}
+
+int main() {
+    const fs::path dir = fs::temp_directory_path() / "recolor_png_test";
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+
+    bool ok = true;
+    const struct { const char* name; cairo_format_t format; } inputs[] = {
+        { "alpha.png", CAIRO_FORMAT_ARGB32 },
+        { "opaque.png", CAIRO_FORMAT_RGB24 },
+    };
+    for (const auto& in : inputs) {
+        const std::string path = (dir / in.name).string();
+        if (!write_input(path, in.format)) {
+            std::fprintf(stderr, "Failed to write %s\n", path.c_str());
+            ok = false;
+            continue;
+        }
+        std::printf("%s:\n", in.name);
+        std::fflush(stdout);
+        ok &= recolor_verify_fused(path.c_str());
+    }
+    fs::remove_all(dir, ec);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+// Command-line client for render_daemon.
+//   render_client [--socket path] '<json job>' ['<json job>' ...]
+//   render_client [--socket path] < jobs.jsonl
+// Prints one JSON reply per job; exits non-zero if any job failed.
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static const char* kDefaultSocket = "/tmp/render_daemon.sock";
+
+int main(int argc, char** argv) {
+    std::string sock_path = kDefaultSocket;
+    std::string jobs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) { sock_path = argv[++i]; continue; }
+        jobs += arg + "\n";
+    }
+    if (jobs.empty()) {
+        std::string line;
+        while (std::getline(std::cin, line)) jobs += line + "\n";
+    }
+    if (jobs.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--socket path] '<json job>' ... (or jobs on stdin)\n";
+        return 1;
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, sock_path.c_str(), sizeof(addr.sun_path) - 1);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::perror(("connect " + sock_path).c_str());
+        return 1;
+    }
+
+    const char* p = jobs.data();
+    size_t len = jobs.size();
+    while (len > 0) {
+        ssize_t n = ::send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) { std::perror("send"); ::close(fd); return 1; }
+        p += n; len -= (size_t)n;
+    }
+    ::shutdown(fd, SHUT_WR);  // end of jobs; the daemon replies once all are done
+
+    std::string replies;
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::recv(fd, buf, sizeof(buf), 0)) > 0) replies.append(buf, (size_t)n);
+    ::close(fd);
+
+    std::cout << replies;
+    return replies.find("\"ok\":false") == std::string::npos ? 0 : 2;
+}
@@ -0,0 +1,522 @@
+// Long-running render daemon: accepts JSON jobs over a Unix socket, runs them on a
+// worker pool by priority, coalesces identical in-flight jobs and keeps a
+// content-addressed output cache so repeated jobs are a file copy.
+//
+// Build: the CMake `render_daemon` target (needs cairo, librsvg-2.0 and nlohmann_json).
+// It links render_tools, which compiles recolor_png.cpp and cairo_set_source_rgba.cpp
+// with -DRENDER_TOOL_NO_MAIN on top of overlay_render.
+//
+// Protocol: the client writes one JSON object per line, then half-closes the socket.
+// The daemon answers one JSON line per job, in request order:
+//   {"op":"tint","input":"in.png","output":"out.png","color":"#ff8800","priority":5}
+//   {"op":"recolor","input":"in.png","output":"out.png","color":[1,0,0,1]}
+//   {"op":"hue_shift","input":"in.png","output":"out.png","hue":40}
+//   {"op":"colored_frame","key":"red","width":800,"height":300,"output":"frame.png"}
+//   {"op":"svg","input":"border/a.svg","width":256,"height":256,"output":"a.png"}
+//   -> {"ok":true,"output":"out.png","cached":false,"coalesced":false,"ms":12.3}
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cairo.h>
+#include <nlohmann/json.hpp>
+
+#include "cairo_set_source_rgba.hpp"
+#include "color_math.hpp"
+#include "recolor_png.hpp"
+#include "rsvg_render.hpp"
+
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+
+static const char* kDefaultSocket   = "/tmp/render_daemon.sock";
+static const char* kDefaultCacheDir = "render_cache";
+
+struct JobResult {
+    bool ok = false;
+    std::string error;
+    std::string cache_path;
+    bool cached = false;
+};
+
+struct Job {
+    json spec;             // validated request, without output/priority
+    std::string cache_path;
+    int priority = 0;
+    uint64_t seq = 0;
+    std::shared_ptr<std::promise<JobResult>> done;
+};
+
+struct JobOrder {
+    // Higher priority first, then FIFO
+    bool operator()(const Job& a, const Job& b) const {
+        if (a.priority != b.priority) return a.priority < b.priority;
+        return a.seq > b.seq;
+    }
+};
+
+// ---------- cache key ----------
+static void fnv1a(uint64_t& h, const char* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) { h ^= (unsigned char)data[i]; h *= 1099511628211ull; }
+}
+
+// Hash of the canonical job spec plus the bytes of its input file (if any).
+// nlohmann::json objects are key-sorted, so dump() is canonical.
+static bool job_hash(const json& spec, uint64_t& out) {
+    uint64_t h = 1469598103934665603ull;
+    std::string canon = spec.dump();
+    fnv1a(h, canon.data(), canon.size());
+
+    if (spec.contains("input")) {
+        std::ifstream in(spec["input"].get<std::string>(), std::ios::binary);
+        if (!in) return false;
+        char buf[64 * 1024];
+        while (in.read(buf, sizeof(buf)) || in.gcount() > 0)
+            fnv1a(h, buf, (size_t)in.gcount());
+    }
+    out = h;
+    return true;
+}
+
+static bool parse_color(const json& c, double& r, double& g, double& b, double& a) {
+    if (c.is_string()) return parse_hex_rgba(c.get<std::string>(), r, g, b, a);
+    if (c.is_array() && (c.size() == 3 || c.size() == 4)) {
+        r = c[0].get<double>(); g = c[1].get<double>(); b = c[2].get<double>();
+        a = c.size() == 4 ? c[3].get<double>() : 1.0;
+        return true;
+    }
+    return false;
+}
+
+// Strip routing fields and check required ones; the result is what gets hashed.
+// Field types are checked here so nothing later has to catch json::type_error.
+static bool normalize_spec(const json& req, json& spec, std::string& err) {
+    if (!req.is_object() || !req.contains("op") || !req["op"].is_string()) {
+        err = "missing op"; return false;
+    }
+    if (req.contains("output") && !req["output"].is_string()) { err = "output must be a string"; return false; }
+    if (req.contains("priority") && !req["priority"].is_number_integer()) {
+        err = "priority must be an integer"; return false;
+    }
+    spec = req;
+    spec.erase("output");
+    spec.erase("priority");
+    spec.erase("id");
+
+    const std::string op = spec["op"];
+    auto need = [&](const char* k) {
+        if (spec.contains(k)) return true;
+        err = std::string("missing ") + k;
+        return false;
+    };
+    auto need_string = [&](const char* k) {
+        if (!need(k)) return false;
+        if (spec[k].is_string()) return true;
+        err = std::string(k) + " must be a string";
+        return false;
+    };
+    auto need_number = [&](const char* k) {
+        if (!need(k)) return false;
+        if (spec[k].is_number()) return true;
+        err = std::string(k) + " must be a number";
+        return false;
+    };
+    auto need_size = [&](const char* k) {
+        if (!need(k)) return false;
+        if (spec[k].is_number_integer() && spec[k].get<long long>() > 0 && spec[k].get<long long>() <= 32768)
+            return true;
+        err = std::string(k) + " must be an integer in 1..32768";
+        return false;
+    };
+    auto need_color = [&]() {
+        if (!need("color")) return false;
+        double r, g, b, a;
+        const json& c = spec["color"];
+        bool numbers = c.is_string();
+        if (c.is_array()) {
+            numbers = true;
+            for (const json& v : c) numbers = numbers && v.is_number();
+        }
+        if (numbers && parse_color(c, r, g, b, a)) return true;
+        err = "bad color";
+        return false;
+    };
+    if (op == "tint" || op == "recolor") return need_string("input") && need_color();
+    if (op == "hue_shift")               return need_string("input") && need_number("hue");
+    if (op == "colored_frame")           return need_string("key") && need_size("width") && need_size("height");
+    if (op == "svg")                     return need_string("input") && need_size("width") && need_size("height");
+    err = "unknown op " + op;
+    return false;
+}
+
+// ---------- rendering ----------
+static bool write_surface_png(cairo_surface_t* s, const std::string& path) {
+    return s && cairo_surface_write_to_png(s, path.c_str()) == CAIRO_STATUS_SUCCESS;
+}
+
+static bool run_job(const json& spec, const std::string& out, std::string& err) {
+    try {
+        const std::string op = spec["op"];
+        if (op == "tint" || op == "recolor") {
+            double r, g, b, a;
+            if (!parse_color(spec["color"], r, g, b, a)) { err = "bad color"; return false; }
+            std::string in = spec["input"];
+            if (op == "tint") tint_png_multiply(in.c_str(), out.c_str(), r, g, b, a);
+            else              recolor_png_with_alpha_mask(in.c_str(), out.c_str(), r, g, b, a);
+        } else if (op == "hue_shift") {
+            std::string in = spec["input"];
+            hue_shift_png(in.c_str(), out.c_str(), spec["hue"].get<double>());
+        } else if (op == "colored_frame") {
+            draw_colored_frame(spec["key"].get<std::string>(), spec["width"].get<int>(),
+                               spec["height"].get<int>(), out.c_str());
+        } else if (op == "svg") {
+            // One rasterizer thread per job: the worker pool already spreads jobs over the cores
+            cairo_surface_t* s = renderSvgToSurface(spec["input"].get<std::string>(),
+                                                    spec["width"].get<int>(), spec["height"].get<int>(), 1);
+            bool ok = write_surface_png(s, out);
+            if (s) cairo_surface_destroy(s);
+            if (!ok) { err = "svg render failed"; return false; }
+        }
+    } catch (const std::exception& e) {
+        err = e.what();
+        return false;
+    }
+    // The recolor tools report failures on stderr only; a missing file is the signal
+    std::error_code ec;
+    if (!fs::exists(out, ec)) { err = "render produced no output"; return false; }
+    return true;
+}
+
+// ---------- daemon ----------
+class RenderDaemon {
+public:
+    RenderDaemon(std::string cache_dir, int threads) : cache_dir_(std::move(cache_dir)) {
+        fs::create_directories(cache_dir_);
+        for (int i = 0; i < threads; ++i) workers_.emplace_back([this] { workerLoop(); });
+    }
+
+    ~RenderDaemon() {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    // Returns a future for the job; sets coalesced when an identical job is in flight.
+    std::shared_future<JobResult> submit(const json& spec, int priority, bool& coalesced) {
+        coalesced = false;
+        uint64_t h = 0;
+        if (!job_hash(spec, h)) {
+            std::promise<JobResult> p;
+            JobResult r; r.error = "cannot read input";
+            p.set_value(r);
+            return p.get_future().share();
+        }
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.png", (unsigned long long)h);
+        std::string cache_path = (fs::path(cache_dir_) / name).string();
+
+        // Cache hits skip the queue entirely
+        if (fs::exists(cache_path)) {
+            std::promise<JobResult> p;
+            JobResult r;
+            r.ok = true;
+            r.cached = true;
+            r.cache_path = cache_path;
+            p.set_value(r);
+            return p.get_future().share();
+        }
+
+        std::lock_guard<std::mutex> lk(mutex_);
+        auto it = inflight_.find(h);
+        if (it != inflight_.end()) {
+            coalesced = true;
+            return it->second;
+        }
+
+        Job job;
+        job.spec = spec;
+        job.cache_path = cache_path;
+        job.priority = priority;
+        job.seq = next_seq_++;
+        job.done = std::make_shared<std::promise<JobResult>>();
+        std::shared_future<JobResult> fut = job.done->get_future().share();
+        inflight_[h] = fut;
+        pending_hash_[job.seq] = h;
+        queue_.push(std::move(job));
+        cv_.notify_one();
+        return fut;
+    }
+
+private:
+    void workerLoop() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lk(mutex_);
+                cv_.wait(lk, [&] { return stopping_ || !queue_.empty(); });
+                if (stopping_ && queue_.empty()) return;
+                job = queue_.top();
+                queue_.pop();
+            }
+
+            JobResult r;
+            r.cache_path = job.cache_path;
+            if (fs::exists(job.cache_path)) {
+                r.ok = true;
+                r.cached = true;
+            } else {
+                // Render beside the cache entry and rename so readers never see a partial PNG
+                std::string tmp = job.cache_path + ".tmp" + std::to_string(job.seq) + ".png";
+                r.ok = run_job(job.spec, tmp, r.error);
+                std::error_code ec;
+                if (r.ok) {
+                    fs::rename(tmp, job.cache_path, ec);
+                    if (ec) { r.ok = false; r.error = ec.message(); }
+                }
+                fs::remove(tmp, ec);
+            }
+
+            {
+                std::lock_guard<std::mutex> lk(mutex_);
+                inflight_.erase(pending_hash_[job.seq]);
+                pending_hash_.erase(job.seq);
+            }
+            job.done->set_value(r);
+        }
+    }
+
+    std::string cache_dir_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::priority_queue<Job, std::vector<Job>, JobOrder> queue_;
+    std::map<uint64_t, std::shared_future<JobResult>> inflight_;
+    std::map<uint64_t, uint64_t> pending_hash_;  // seq -> hash
+    uint64_t next_seq_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+// ---------- connections ----------
+static bool send_line(int fd, const std::string& s) {
+    std::string line = s + "\n";
+    const char* p = line.data();
+    size_t len = line.size();
+    while (len > 0) {
+        ssize_t n = ::send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n; len -= (size_t)n;
+    }
+    return true;
+}
+
+struct PendingReply {
+    json id;
+    std::string output;
+    std::string error;
+    bool coalesced = false;
+    std::shared_future<JobResult> result;
+    std::chrono::steady_clock::time_point start;
+};
+
+static void handle_client(RenderDaemon& daemon, int fd) {
+    std::vector<PendingReply> pending;
+    std::string buf;
+    char chunk[4096];
+
+    auto submit_line = [&](const std::string& line) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) return;
+        PendingReply p;
+        p.start = std::chrono::steady_clock::now();
+        // A bad line gets an error reply; nothing thrown here may reach the thread
+        try {
+            json req = json::parse(line, nullptr, false);
+            json spec;
+            if (req.is_discarded()) {
+                p.error = "invalid json";
+            } else if (!normalize_spec(req, spec, p.error)) {
+                // error already set
+            } else {
+                p.id = req.value("id", json());
+                p.output = req.value("output", std::string());
+                int priority = req.value("priority", 0);
+                p.result = daemon.submit(spec, priority, p.coalesced);
+            }
+        } catch (const std::exception& e) {
+            p.error = e.what();
+            p.result = std::shared_future<JobResult>();
+        }
+        pending.push_back(std::move(p));
+    };
+
+    // Submit every job as soon as its line arrives so the pool can prioritise across them
+    for (;;) {
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) break;
+        buf.append(chunk, (size_t)n);
+        size_t nl;
+        while ((nl = buf.find('\n')) != std::string::npos) {
+            submit_line(buf.substr(0, nl));
+            buf.erase(0, nl + 1);
+        }
+    }
+    submit_line(buf);
+
+    for (auto& p : pending) {
+        json reply;
+        if (!p.id.is_null()) reply["id"] = p.id;
+        if (!p.error.empty() || !p.result.valid()) {
+            reply["ok"] = false;
+            reply["error"] = p.error;
+            send_line(fd, reply.dump());
+            continue;
+        }
+
+        JobResult r = p.result.get();
+        std::string err = r.error;
+        if (r.ok && !p.output.empty()) {
+            std::error_code ec;
+            fs::copy_file(r.cache_path, p.output, fs::copy_options::overwrite_existing, ec);
+            if (ec) { r.ok = false; err = ec.message(); }
+        }
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - p.start).count();
+        reply["ok"] = r.ok;
+        reply["output"] = p.output.empty() ? r.cache_path : p.output;
+        reply["cached"] = r.cached;
+        reply["coalesced"] = p.coalesced;
+        reply["ms"] = ms;
+        if (!r.ok) reply["error"] = err;
+        send_line(fd, reply.dump());
+    }
+}
+
+// Client connections, each on its own thread. They hold a reference to the
+// daemon, so all of them are shut down and joined before it is destroyed.
+class ClientThreads {
+public:
+    ~ClientThreads() { shutdownAll(); }
+
+    void start(RenderDaemon& daemon, int fd) {
+        reap();
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            fds_.insert(fd);
+        }
+        threads_.push_back({ std::thread([this, &daemon, fd, done] {
+            handle_client(daemon, fd);
+            {
+                // Unregister before closing so shutdownAll() never hits a reused fd
+                std::lock_guard<std::mutex> lk(mutex_);
+                fds_.erase(fd);
+                ::close(fd);
+            }
+            *done = true;
+        }), done });
+    }
+
+    // Wake clients blocked in recv/send and wait for them; jobs they already
+    // submitted still finish, since the daemon is alive until this returns
+    void shutdownAll() {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            for (int fd : fds_) ::shutdown(fd, SHUT_RDWR);
+        }
+        for (auto& c : threads_) c.first.join();
+        threads_.clear();
+    }
+
+private:
+    // Join finished connections so a long-running daemon doesn't collect them
+    void reap() {
+        for (auto it = threads_.begin(); it != threads_.end();) {
+            if (*it->second) {
+                it->first.join();
+                it = threads_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::mutex mutex_;
+    std::set<int> fds_;
+    std::vector<std::pair<std::thread, std::shared_ptr<std::atomic<bool>>>> threads_;
+};
+
+static std::atomic<bool> g_stop{false};
+static void on_signal(int) { g_stop = true; }
+
+int main(int argc, char** argv) {
+    std::string sock_path = argc > 1 ? argv[1] : kDefaultSocket;
+    std::string cache_dir = argc > 2 ? argv[2] : kDefaultCacheDir;
+    int threads = argc > 3 ? std::atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 4;
+
+    int srv = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (srv < 0) { std::perror("socket"); return 1; }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (sock_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long: " << sock_path << "\n";
+        return 1;
+    }
+    std::strcpy(addr.sun_path, sock_path.c_str());
+    ::unlink(sock_path.c_str());
+    if (::bind(srv, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(srv, 64) < 0) {
+        std::perror("bind/listen");
+        ::close(srv);
+        return 1;
+    }
+
+    // No SA_RESTART: accept() must return EINTR so the loop sees g_stop
+    struct sigaction sa{};
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    std::cout << "Render daemon on " << sock_path << " (" << threads << " workers, cache "
+              << cache_dir << ")\n";
+    {
+        RenderDaemon daemon(cache_dir, threads);
+        ClientThreads clients;   // declared after the daemon, so destroyed (joined) first
+        while (!g_stop) {
+            int fd = ::accept(srv, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR) continue;  // loop re-checks g_stop
+                std::perror("accept");
+                break;
+            }
+            clients.start(daemon, fd);
+        }
+        clients.shutdownAll();
+    }
+
+    ::close(srv);
+    ::unlink(sock_path.c_str());
+    return 0;
+}
@@ -2,35 +2,155 @@
 #include <cairo.h>           // explicit, even though header already has it
 #include <librsvg/rsvg.h>
 #include <glib.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+#include "trace.hpp"
+#include "surface_pool.hpp"
 
-cairo_surface_t* renderSvgToSurface(const std::string& path, int width, int height) {
-    GError* error = nullptr;
+// Canvases at or above this many pixels are rasterized in tiles across threads
+static const long long kTiledMinPixels = 2048LL * 2048;
+static const int kTileSize = 512;
+
+static void report_error(const char* what, const std::string& path, GError* error) {
+    if (error) {
+        g_printerr("%s %s: %s\n", what, path.c_str(), error->message);
+        g_error_free(error);
+    } else {
+        g_printerr("%s %s: unknown error\n", what, path.c_str());
+    }
+}
 
+static RsvgHandle* open_svg(const std::string& path) {
+    TRACE_SCOPE("svg.parse");
+    GError* error = nullptr;
     RsvgHandle* handle = rsvg_handle_new_from_file(path.c_str(), &error);
-    if (!handle) {
-        if (error) {
-            g_printerr("Error loading %s: %s\n", path.c_str(), error->message);
-            g_error_free(error);
-        } else {
-            g_printerr("Unknown error loading %s\n", path.c_str());
-        }
-        return nullptr;
+    if (!handle) report_error("Error loading", path, error);
+    return handle;
+}
+
+// Filter effects (blur, drop shadow) sample neighbouring pixels through intermediate
+// surfaces, so a tile could see different input at its edges: render those whole.
+// Looks for a <filter> element or a filter attribute / CSS property, not for the
+// bare word (ids, class names and text mentioning it do not count).
+static bool uses_filters(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    auto is_name_char = [](char c) {
+        return std::isalnum((unsigned char)c) || c == '-' || c == '_' || c == ':';
+    };
+    for (size_t pos = text.find("filter"); pos != std::string::npos; pos = text.find("filter", pos + 1)) {
+        size_t end = pos + 6;
+        if (end < text.size() && is_name_char(text[end]) && text[end] != ':') continue;  // filterUnits
+        size_t start = pos;
+        while (start > 0 && is_name_char(text[start - 1])) --start;
+        const bool prefixed = start < pos && text[pos - 1] == ':';    // svg:filter
+        if (start > 0 && text[start - 1] == '<' && (start == pos || prefixed)) return true;
+        if (start != pos) continue;                                   // feFilter, my-filter
+        while (end < text.size() && std::isspace((unsigned char)text[end])) ++end;
+        if (end < text.size() && (text[end] == '=' || text[end] == ':')) return true;
     }
+    return false;
+}
+
+static void render_into(RsvgHandle* handle, const std::string& path, cairo_t* cr, int width, int height) {
+    GError* error = nullptr;
+    RsvgRectangle vp { 0.0, 0.0, (double)width, (double)height };
+    if (!rsvg_handle_render_document(handle, cr, &vp, &error))
+        report_error("Render error for", path, error);
+}
+
+cairo_surface_t* renderSvgToSurface(const std::string& path, int width, int height, unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    if ((long long)width * height >= kTiledMinPixels && threads > 1 && !uses_filters(path))
+        return renderSvgToSurfaceTiled(path, width, height, threads);
 
-    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    RsvgHandle* handle = open_svg(path);
+    if (!handle) return nullptr;
+
+    TRACE_SCOPE("svg.rasterize");
+    TRACE_BYTES((uint64_t)width * height * 4);
+    cairo_surface_t* surface = surface_pool_acquire(width, height);
     cairo_t* cr = cairo_create(surface);
+    render_into(handle, path, cr, width, height);
+
+    cairo_destroy(cr);
+    g_object_unref(handle);
+    return surface;
+}
 
+cairo_surface_t* renderSvgToSurfaceTiled(const std::string& path, int width, int height, unsigned threads) {
+    RsvgHandle* first = open_svg(path);
+    if (!first) return nullptr;
+
+    TRACE_SCOPE("svg.rasterize_tiled");
+    TRACE_BYTES((uint64_t)width * height * 4);
+
+    // Only tiles touching the ink rect (plus a pixel for antialiasing) are drawn
+    int ix0 = 0, iy0 = 0, ix1 = width, iy1 = height;
     RsvgRectangle vp { 0.0, 0.0, (double)width, (double)height };
-    if (!rsvg_handle_render_document(handle, cr, &vp, &error)) {
-        if (error) {
-            g_printerr("Render error for %s: %s\n", path.c_str(), error->message);
-            g_error_free(error);
-        } else {
-            g_printerr("Unknown render error for %s\n", path.c_str());
+    RsvgRectangle ink {}, logical {};
+    GError* error = nullptr;
+    if (rsvg_handle_get_geometry_for_layer(first, nullptr, &vp, &ink, &logical, &error)) {
+        ix0 = std::max(0, (int)std::floor(ink.x) - 1);
+        iy0 = std::max(0, (int)std::floor(ink.y) - 1);
+        ix1 = std::min(width,  (int)std::ceil(ink.x + ink.width) + 1);
+        iy1 = std::min(height, (int)std::ceil(ink.y + ink.height) + 1);
+    } else if (error) {
+        g_error_free(error);
+    }
+
+    struct Tile { int x, y, w, h; };
+    std::vector<Tile> tiles;
+    for (int y = 0; y < height; y += kTileSize) {
+        for (int x = 0; x < width; x += kTileSize) {
+            Tile t { x, y, std::min(kTileSize, width - x), std::min(kTileSize, height - y) };
+            if (t.x + t.w <= ix0 || t.x >= ix1 || t.y + t.h <= iy0 || t.y >= iy1) continue;
+            tiles.push_back(t);
         }
     }
 
-    cairo_destroy(cr);
-    g_object_unref(handle);
+    cairo_surface_t* surface = surface_pool_acquire(width, height);  // skipped tiles stay transparent
+    cairo_surface_flush(surface);
+    unsigned char* data = cairo_image_surface_get_data(surface);
+    const int stride = cairo_image_surface_get_stride(surface);
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, (unsigned)std::max<size_t>(1, tiles.size()));
+
+    // Each worker has its own handle (handles are not shared across threads) and
+    // draws each tile through a surface aliasing that tile's pixels in the shared
+    // buffer, under the same whole-document transform, so no pixel is written twice
+    std::atomic<size_t> next{0};
+    auto worker = [&](RsvgHandle* handle) {
+        if (!handle) return;
+        for (size_t i = next++; i < tiles.size(); i = next++) {
+            const Tile& t = tiles[i];
+            cairo_surface_t* sub = cairo_image_surface_create_for_data(
+                data + (size_t)t.y * stride + (size_t)t.x * 4, CAIRO_FORMAT_ARGB32, t.w, t.h, stride);
+            cairo_t* cr = cairo_create(sub);
+            cairo_rectangle(cr, 0, 0, t.w, t.h);
+            cairo_clip(cr);
+            cairo_translate(cr, -t.x, -t.y);
+            render_into(handle, path, cr, width, height);
+            cairo_destroy(cr);
+            cairo_surface_finish(sub);
+            cairo_surface_destroy(sub);
+        }
+        g_object_unref(handle);
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned k = 1; k < threads; ++k)
+        pool.emplace_back([&] { worker(open_svg(path)); });
+    worker(first);
+    for (auto& th : pool) th.join();
+
+    cairo_surface_mark_dirty(surface);
     return surface;
 }
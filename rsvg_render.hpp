@@ -5,6 +5,16 @@
 #include <cairo.h>
 
 // Rendering SVG's
-cairo_surface_t* renderSvgToSurface(const std::string& path, int width, int height);
+// Single-threaded by default. With `threads` > 1 (0 = hardware concurrency),
+// canvases of 4 MP and up are handed to renderSvgToSurfaceTiled unless the
+// document uses filter effects.
+cairo_surface_t* renderSvgToSurface(const std::string& path, int width, int height,
+                                    unsigned threads = 1);
 
-#endif
\ No newline at end of file
+// Same pixels as a single-threaded render (rsvg_render_test compares the two),
+// rasterized in 512px tiles on `threads` workers (0 = hardware concurrency).
+// Tiles outside the document's ink rect are skipped and left transparent.
+cairo_surface_t* renderSvgToSurfaceTiled(const std::string& path, int width, int height,
+                                         unsigned threads = 0);
+
+#endif
\ No newline at end of file
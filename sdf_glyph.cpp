@@ -0,0 +1,386 @@
+#include "sdf_glyph.hpp"
+#include "rsvg_render.hpp"
+#include "surface_pool.hpp"
+#include <cairo.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static const int  kOversample = 4;                 // high-res raster per cell pixel
+static const char kSdfMagic[4] = { 'S', 'D', 'F', '1' };
+static const float kInf = 1e20f;
+
+// Inverse of getSvgPathForChar(): "colon.svg" -> ':', "7.svg" -> '7'
+static bool char_for_svg(const fs::path& p, char& c) {
+    if (p.extension() != ".svg") return false;
+    const std::string stem = p.stem().string();
+    if (stem == "colon") { c = ':'; return true; }
+    if (stem.size() == 1) { c = stem[0]; return true; }
+    return false;
+}
+
+static int64_t newest_svg_mtime(const std::string& dir) {
+    int64_t newest = 0;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(dir, ec)) {
+        char c;
+        if (!char_for_svg(e.path(), c)) continue;
+        auto t = fs::last_write_time(e.path(), ec);
+        if (!ec) newest = std::max<int64_t>(newest, (int64_t)t.time_since_epoch().count());
+    }
+    return newest;
+}
+
+// ---- Euclidean distance transform (Felzenszwalb & Huttenlocher), squared distances ----
+static void edt_1d(const float* f, float* d, int n, int* v, float* z) {
+    int k = 0;
+    v[0] = 0; z[0] = -kInf; z[1] = kInf;
+    auto meet = [&](int q, int p) {
+        return ((f[q] + (float)q * q) - (f[p] + (float)p * p)) / (2.0f * (q - p));
+    };
+    for (int q = 1; q < n; ++q) {
+        float s = meet(q, v[k]);
+        while (s <= z[k]) { --k; s = meet(q, v[k]); }
+        ++k; v[k] = q; z[k] = s; z[k + 1] = kInf;
+    }
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < q) ++k;
+        const float dq = (float)(q - v[k]);
+        d[q] = dq * dq + f[v[k]];
+    }
+}
+
+// grid: 0 on feature pixels, kInf elsewhere; replaced by squared distance to nearest feature
+static void edt_2d(std::vector<float>& grid, int w, int h) {
+    const int n = std::max(w, h);
+    std::vector<float> f(n), d(n), z(n + 1);
+    std::vector<int> v(n);
+    for (int x = 0; x < w; ++x) {
+        for (int y = 0; y < h; ++y) f[y] = grid[(size_t)y * w + x];
+        edt_1d(f.data(), d.data(), h, v.data(), z.data());
+        for (int y = 0; y < h; ++y) grid[(size_t)y * w + x] = d[y];
+    }
+    for (int y = 0; y < h; ++y) {
+        float* row = &grid[(size_t)y * w];
+        std::copy(row, row + w, f.begin());
+        edt_1d(f.data(), row, w, v.data(), z.data());
+    }
+}
+
+// Rasterize one SVG large, then reduce it to a cell of signed distances
+// (threads: the rasterizer's budget, 1 when called from the build pool)
+static bool build_cell(const std::string& svg, const SdfAtlas& atlas, uint8_t* cell, uint32_t& color,
+                       unsigned threads) {
+    const int W = atlas.cell_width * kOversample, H = atlas.cell_height * kOversample;
+    cairo_surface_t* s = renderSvgToSurface(svg, W, H, threads);
+    if (!s) return false;
+    cairo_surface_flush(s);
+    const unsigned char* data = cairo_image_surface_get_data(s);
+    const int stride = cairo_image_surface_get_stride(s);
+
+    std::vector<float> to_inside((size_t)W * H), to_outside((size_t)W * H);
+    double sum_a = 0, sum_r = 0, sum_g = 0, sum_b = 0;
+    for (int y = 0; y < H; ++y) {
+        const uint32_t* row = reinterpret_cast<const uint32_t*>(data + (size_t)y * stride);
+        for (int x = 0; x < W; ++x) {
+            const uint32_t p = row[x];
+            const uint32_t a = p >> 24;
+            const bool inside = a >= 128;
+            to_inside[(size_t)y * W + x]  = inside ? 0.0f : kInf;
+            to_outside[(size_t)y * W + x] = inside ? kInf : 0.0f;
+            // premultiplied sums give the alpha-weighted average colour directly
+            sum_a += a; sum_r += (p >> 16) & 0xFF; sum_g += (p >> 8) & 0xFF; sum_b += p & 0xFF;
+        }
+    }
+    cairo_surface_destroy(s);
+
+    edt_2d(to_inside, W, H);
+    edt_2d(to_outside, W, H);
+
+    // Average the oversampled signed distance over each cell pixel's footprint
+    const float scale = 127.0f / ((float)atlas.spread * kOversample);
+    for (int cy = 0; cy < atlas.cell_height; ++cy) {
+        for (int cx = 0; cx < atlas.cell_width; ++cx) {
+            float acc = 0.0f;
+            for (int oy = 0; oy < kOversample; ++oy) {
+                for (int ox = 0; ox < kOversample; ++ox) {
+                    const size_t i = (size_t)(cy * kOversample + oy) * W + (cx * kOversample + ox);
+                    acc += (to_outside[i] > 0.0f)
+                        ? std::sqrt(to_outside[i]) - 0.5f      // inside: distance to the edge
+                        : 0.5f - std::sqrt(to_inside[i]);      // outside: negative
+                }
+            }
+            const float d = acc / (kOversample * kOversample);
+            cell[(size_t)cy * atlas.cell_width + cx] =
+                (uint8_t)std::clamp(128.0f + d * scale, 0.0f, 255.0f);
+        }
+    }
+
+    if (sum_a > 0) {
+        auto ch = [&](double c) { return (uint32_t)std::min(255.0, std::round(c * 255.0 / sum_a)); };
+        color = 0xFF000000u | (ch(sum_r) << 16) | (ch(sum_g) << 8) | ch(sum_b);
+    }
+    return true;
+}
+
+SdfAtlas sdf_atlas_build(const std::string& chars_dir, int cell_width, int cell_height, int spread) {
+    SdfAtlas atlas;
+    atlas.cell_width  = cell_width;
+    atlas.cell_height = cell_height;
+    atlas.spread      = std::max(1, spread);
+    atlas.source_mtime = newest_svg_mtime(chars_dir);
+
+    std::vector<std::pair<char, std::string>> svgs;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(chars_dir, ec)) {
+        char c;
+        if (e.is_regular_file() && char_for_svg(e.path(), c))
+            svgs.push_back({ c, e.path().string() });
+    }
+    if (svgs.empty()) return atlas;
+
+    const size_t cell_bytes = (size_t)cell_width * cell_height;
+    std::vector<uint8_t> pixels(cell_bytes * svgs.size(), 0);
+    std::vector<uint32_t> colors(svgs.size(), 0xFFFFFFFFu);
+    std::vector<char> ok(svgs.size(), 0);
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < svgs.size(); i = next++)
+            ok[i] = build_cell(svgs[i].second, atlas, &pixels[i * cell_bytes], colors[i], 1);
+    };
+    unsigned threads = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(), (unsigned)svgs.size()));
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) pool.emplace_back(worker);
+    for (auto& th : pool) th.join();
+
+    // Pack the successful cells
+    for (size_t i = 0; i < svgs.size(); ++i) {
+        if (!ok[i]) continue;
+        SdfGlyph g;
+        g.offset = atlas.pixels.size();
+        g.color  = colors[i];
+        atlas.pixels.insert(atlas.pixels.end(), pixels.begin() + i * cell_bytes,
+                            pixels.begin() + (i + 1) * cell_bytes);
+        atlas.glyphs[svgs[i].first] = g;
+    }
+    return atlas;
+}
+
+bool sdf_atlas_save(const SdfAtlas& atlas, const std::string& path) {
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        int32_t hdr[4] = { atlas.cell_width, atlas.cell_height, atlas.spread, (int32_t)atlas.glyphs.size() };
+        out.write(kSdfMagic, 4);
+        out.write(reinterpret_cast<const char*>(hdr), sizeof(hdr));
+        out.write(reinterpret_cast<const char*>(&atlas.source_mtime), sizeof(atlas.source_mtime));
+        const size_t cell_bytes = (size_t)atlas.cell_width * atlas.cell_height;
+        for (const auto& kv : atlas.glyphs) {
+            out.put(kv.first);
+            out.write(reinterpret_cast<const char*>(&kv.second.color), sizeof(uint32_t));
+            out.write(reinterpret_cast<const char*>(&atlas.pixels[kv.second.offset]), cell_bytes);
+        }
+        if (!out) { std::remove(tmp.c_str()); return false; }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) { std::remove(tmp.c_str()); return false; }
+    return true;
+}
+
+bool sdf_atlas_load(SdfAtlas& atlas, const std::string& path, const std::string& chars_dir) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    char magic[4];
+    int32_t hdr[4];
+    int64_t mtime = 0;
+    if (!in.read(magic, 4) || std::memcmp(magic, kSdfMagic, 4) != 0) return false;
+    if (!in.read(reinterpret_cast<char*>(hdr), sizeof(hdr))) return false;
+    if (!in.read(reinterpret_cast<char*>(&mtime), sizeof(mtime))) return false;
+    if (hdr[0] <= 0 || hdr[1] <= 0 || hdr[0] > 1024 || hdr[1] > 1024 || hdr[3] < 0 || hdr[3] > 256) return false;
+    if (mtime < newest_svg_mtime(chars_dir)) return false;  // an SVG was edited since
+
+    SdfAtlas a;
+    a.cell_width = hdr[0]; a.cell_height = hdr[1]; a.spread = std::max(1, hdr[2]);
+    a.source_mtime = mtime;
+    const size_t cell_bytes = (size_t)a.cell_width * a.cell_height;
+    a.pixels.resize(cell_bytes * hdr[3]);
+    for (int i = 0; i < hdr[3]; ++i) {
+        char c;
+        SdfGlyph g;
+        g.offset = cell_bytes * i;
+        if (!in.get(c)) return false;
+        if (!in.read(reinterpret_cast<char*>(&g.color), sizeof(uint32_t))) return false;
+        if (!in.read(reinterpret_cast<char*>(&a.pixels[g.offset]), cell_bytes)) return false;
+        a.glyphs[c] = g;
+    }
+    atlas = std::move(a);
+    return true;
+}
+
+bool sdf_atlas_update_glyph(SdfAtlas& atlas, const std::string& svg_path) {
+    char c;
+    if (atlas.cell_width <= 0 || atlas.cell_height <= 0 || !char_for_svg(svg_path, c)) return false;
+
+    std::error_code ec;
+    if (!fs::is_regular_file(svg_path, ec)) {
+        // Deleted: drop the glyph (its cell stays in pixels until the next full build)
+        return atlas.glyphs.erase(c) > 0;
+    }
+
+    const size_t cell_bytes = (size_t)atlas.cell_width * atlas.cell_height;
+    std::vector<uint8_t> cell(cell_bytes, 0);
+    uint32_t color = 0xFFFFFFFFu;
+    if (!build_cell(svg_path, atlas, cell.data(), color, 0)) return false;
+
+    auto it = atlas.glyphs.find(c);
+    if (it == atlas.glyphs.end()) {
+        SdfGlyph g;
+        g.offset = atlas.pixels.size();
+        atlas.pixels.resize(atlas.pixels.size() + cell_bytes);
+        it = atlas.glyphs.emplace(c, g).first;
+    }
+    it->second.color = color;
+    std::copy(cell.begin(), cell.end(), atlas.pixels.begin() + it->second.offset);
+
+    auto t = fs::last_write_time(svg_path, ec);
+    if (!ec) atlas.source_mtime = std::max<int64_t>(atlas.source_mtime, (int64_t)t.time_since_epoch().count());
+    return true;
+}
+
+// ---- Sampling / shading ----
+struct PremulColor { float r, g, b, a; };
+
+static PremulColor premul(uint32_t argb) {
+    const float a = (argb >> 24) / 255.0f;
+    return { ((argb >> 16) & 0xFF) / 255.0f * a, ((argb >> 8) & 0xFF) / 255.0f * a,
+             (argb & 0xFF) / 255.0f * a, a };
+}
+
+// Layers bottom to top: glow, outline, fill. `d` is signed distance in output pixels.
+struct ShadeParams {
+    PremulColor fill, outline, glow;
+    float outline_w, inv_glow_r;
+    bool  has_outline, has_glow;
+};
+
+static inline uint32_t shade_1(float d, const ShadeParams& p) {
+    float af = std::clamp(d + 0.5f, 0.0f, 1.0f);
+    float ao = p.has_outline ? std::clamp(d + p.outline_w + 0.5f, 0.0f, 1.0f) : 0.0f;
+    float ag = 0.0f;
+    if (p.has_glow) { float t = std::clamp(1.0f + (d + p.outline_w) * p.inv_glow_r, 0.0f, 1.0f); ag = t * t; }
+
+    auto over = [&](float top_c, float top_cov, float top_a, float under) {
+        return top_c * top_cov + under * (1.0f - top_a * top_cov);
+    };
+    float out[4];
+    const float fc[4] = { p.fill.r, p.fill.g, p.fill.b, p.fill.a };
+    const float oc[4] = { p.outline.r, p.outline.g, p.outline.b, p.outline.a };
+    const float gc[4] = { p.glow.r, p.glow.g, p.glow.b, p.glow.a };
+    for (int i = 0; i < 4; ++i) {
+        float c = gc[i] * ag;
+        c = over(oc[i], ao, p.outline.a, c);
+        c = over(fc[i], af, p.fill.a, c);
+        out[i] = c;
+    }
+    auto q = [](float c) { return (uint32_t)(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f); };
+    return (q(out[3]) << 24) | (q(out[0]) << 16) | (q(out[1]) << 8) | q(out[2]);
+}
+
+static void shade_row(const float* dist, uint32_t* out, int n, const ShadeParams& p) {
+    int x = 0;
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+    const __m128 k255 = _mm_set1_ps(255.0f);
+    const __m128 ow = _mm_set1_ps(p.outline_w), igr = _mm_set1_ps(p.inv_glow_r);
+    const __m128 fa = _mm_set1_ps(p.fill.a), oa = _mm_set1_ps(p.outline.a);
+    auto clamp01 = [&](__m128 v) { return _mm_min_ps(_mm_max_ps(v, zero), one); };
+    for (; x + 4 <= n; x += 4) {
+        const __m128 d = _mm_loadu_ps(dist + x);
+        const __m128 af = clamp01(_mm_add_ps(d, half));
+        const __m128 ao = p.has_outline ? clamp01(_mm_add_ps(_mm_add_ps(d, ow), half)) : zero;
+        __m128 ag = zero;
+        if (p.has_glow) {
+            __m128 t = clamp01(_mm_add_ps(one, _mm_mul_ps(_mm_add_ps(d, ow), igr)));
+            ag = _mm_mul_ps(t, t);
+        }
+        const __m128 keep_o = _mm_sub_ps(one, _mm_mul_ps(oa, ao));
+        const __m128 keep_f = _mm_sub_ps(one, _mm_mul_ps(fa, af));
+        auto channel = [&](float f, float o, float g) {
+            __m128 c = _mm_mul_ps(_mm_set1_ps(g), ag);
+            c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(o), ao), _mm_mul_ps(c, keep_o));
+            c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(f), af), _mm_mul_ps(c, keep_f));
+            return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamp01(c), k255), half));
+        };
+        __m128i px = _mm_slli_epi32(channel(p.fill.a, p.outline.a, p.glow.a), 24);
+        px = _mm_or_si128(px, _mm_slli_epi32(channel(p.fill.r, p.outline.r, p.glow.r), 16));
+        px = _mm_or_si128(px, _mm_slli_epi32(channel(p.fill.g, p.outline.g, p.glow.g), 8));
+        px = _mm_or_si128(px, channel(p.fill.b, p.outline.b, p.glow.b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), px);
+    }
+#endif
+    for (; x < n; ++x) out[x] = shade_1(dist[x], p);
+}
+
+cairo_surface_t* sdf_render_glyph(const SdfAtlas& atlas, char c, int width, int height, const SdfStyle& style) {
+    auto it = atlas.glyphs.find(c);
+    if (it == atlas.glyphs.end() || width <= 0 || height <= 0) return nullptr;
+
+    const int cw = atlas.cell_width, ch = atlas.cell_height;
+    const uint8_t* cell = &atlas.pixels[it->second.offset];
+
+    // 8-bit field value -> signed distance in output pixels
+    const float out_scale = std::min((float)width / cw, (float)height / ch);
+    const float to_dist = atlas.spread * out_scale / 127.0f;
+
+    ShadeParams p;
+    p.fill        = premul(style.override_fill ? style.fill_color : it->second.color);
+    p.outline     = premul(style.outline_color);
+    p.glow        = premul(style.glow_color);
+    p.has_outline = style.outline_width > 0.0;
+    p.has_glow    = style.glow_radius > 0.0;
+    p.outline_w   = p.has_outline ? (float)style.outline_width : 0.0f;
+    p.inv_glow_r  = p.has_glow ? 1.0f / (float)style.glow_radius : 0.0f;
+
+    // Bilinear taps per column, computed once
+    std::vector<int> x0(width), x1(width);
+    std::vector<float> fx(width);
+    for (int x = 0; x < width; ++x) {
+        float sx = std::clamp((x + 0.5f) * cw / width - 0.5f, 0.0f, (float)(cw - 1));
+        x0[x] = (int)sx; x1[x] = std::min(x0[x] + 1, cw - 1); fx[x] = sx - x0[x];
+    }
+
+    cairo_surface_t* out = surface_pool_acquire(width, height, false);  // every pixel is written
+    unsigned char* data = cairo_image_surface_get_data(out);
+    const int stride = cairo_image_surface_get_stride(out);
+
+    std::vector<float> dist(width);
+    for (int y = 0; y < height; ++y) {
+        float sy = std::clamp((y + 0.5f) * ch / height - 0.5f, 0.0f, (float)(ch - 1));
+        const int y0 = (int)sy, y1 = std::min(y0 + 1, ch - 1);
+        const float fy = sy - y0;
+        const uint8_t* r0 = cell + (size_t)y0 * cw;
+        const uint8_t* r1 = cell + (size_t)y1 * cw;
+        for (int x = 0; x < width; ++x) {
+            const float top = r0[x0[x]] + (r0[x1[x]] - r0[x0[x]]) * fx[x];
+            const float bot = r1[x0[x]] + (r1[x1[x]] - r1[x0[x]]) * fx[x];
+            dist[x] = (top + (bot - top) * fy - 128.0f) * to_dist;
+        }
+        shade_row(dist.data(), reinterpret_cast<uint32_t*>(data + (size_t)y * stride), width, p);
+    }
+    cairo_surface_mark_dirty(out);
+    return out;
+}
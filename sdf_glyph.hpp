@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cairo.h>
+
+// Signed-distance-field glyphs: each chars/ SVG is rasterized once at high
+// resolution, converted to a small 8-bit distance field, and any output size is
+// produced by sampling that field. Glyphs come out in a single colour (the SVG's
+// alpha-weighted average unless overridden).
+
+struct SdfGlyph {
+    size_t   offset = 0;          // into SdfAtlas::pixels
+    uint32_t color  = 0xFFFFFFFF; // straight ARGB
+};
+
+struct SdfAtlas {
+    int cell_width  = 0;
+    int cell_height = 0;
+    int spread      = 0;          // distance (cell pixels) mapped to the 0..255 range
+    int64_t source_mtime = 0;     // newest SVG used to build the atlas
+    std::unordered_map<char, SdfGlyph> glyphs;
+    std::vector<uint8_t> pixels;  // 128 = edge, >128 inside
+};
+
+// Optional effects, sizes in output pixels, colours straight ARGB
+struct SdfStyle {
+    bool     override_fill = false;
+    uint32_t fill_color    = 0xFFFFFFFF;
+    double   outline_width = 0.0;
+    uint32_t outline_color = 0xFF000000;
+    double   glow_radius   = 0.0;
+    uint32_t glow_color    = 0x80FFFFFF;
+};
+
+// Build from every SVG in chars_dir ("colon.svg" -> ':', "7.svg" -> '7').
+// Glyphs are rasterized on all cores. Returns an empty atlas if nothing loads.
+SdfAtlas sdf_atlas_build(const std::string& chars_dir, int cell_width = 48, int cell_height = 72,
+                         int spread = 8);
+
+bool sdf_atlas_save(const SdfAtlas& atlas, const std::string& path);
+
+// Load a saved atlas; fails if it is older than any SVG in chars_dir.
+bool sdf_atlas_load(SdfAtlas& atlas, const std::string& path, const std::string& chars_dir);
+
+// Rebuild the one cell drawn from svg_path (as passed to the watcher, e.g.
+// "chars/7.svg") after it was edited, added or deleted, and bump source_mtime.
+// Returns false if the path is not a glyph SVG or the atlas is unchanged.
+bool sdf_atlas_update_glyph(SdfAtlas& atlas, const std::string& svg_path);
+
+// Render `c` at width x height into a new ARGB32 surface, or nullptr if the atlas lacks it.
+cairo_surface_t* sdf_render_glyph(const SdfAtlas& atlas, char c, int width, int height,
+                                  const SdfStyle& style = SdfStyle());
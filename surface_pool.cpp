@@ -0,0 +1,141 @@
+#include "surface_pool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+static const size_t kAlign      = 4096;            // page aligned, also fine for AVX
+static const size_t kSmallAlign = 64;              // cache line, for classes under a few pages
+static const size_t kPageClass  = 64 * 1024;       // classes from here up are page aligned
+static const size_t kMinClass   = 4 * 1024;        // glyphs are often only a few KB
+
+struct PooledBuffer {
+    void* data;
+    size_t size;   // size class, not the requested size
+};
+
+static std::mutex g_mutex;
+static std::unordered_map<size_t, std::vector<void*>> g_free;  // size class -> idle buffers
+static SurfacePoolStats g_stats;
+static size_t g_max_idle = 0;
+static bool g_max_idle_init = false;
+
+static cairo_user_data_key_t g_pool_key;
+
+// Four classes per power of two (x1, x1.25, x1.5, x1.75): at most 25% slack
+static size_t size_class(size_t bytes) {
+    if (bytes <= kMinClass) return kMinClass;
+    size_t pow2 = kMinClass;
+    while (pow2 * 2 < bytes) pow2 *= 2;
+    for (size_t q = 5; q <= 8; ++q) {
+        size_t c = pow2 / 4 * q;
+        if (c >= bytes) return c;
+    }
+    return pow2 * 2;
+}
+
+// Every class is a multiple of its alignment, as aligned_alloc requires
+static size_t class_align(size_t cls) {
+    return cls >= kPageClass ? kAlign : kSmallAlign;
+}
+
+static void init_max_idle_locked() {
+    if (g_max_idle_init) return;
+    g_max_idle_init = true;
+    const char* env = std::getenv("SURFACE_POOL_MAX_MB");
+    g_max_idle = (env ? (size_t)std::strtoull(env, nullptr, 10) : 256) * 1024 * 1024;
+}
+
+static void update_peak_locked() {
+    g_stats.peak_bytes = std::max(g_stats.peak_bytes, g_stats.in_use_bytes + g_stats.idle_bytes);
+}
+
+// cairo user-data destroy hook: runs when the surface is finalized
+static void release_buffer(void* p) {
+    PooledBuffer* buf = static_cast<PooledBuffer*>(p);
+    {
+        std::lock_guard<std::mutex> lk(g_mutex);
+        init_max_idle_locked();
+        g_stats.in_use_bytes -= buf->size;
+        if (g_stats.idle_bytes + buf->size <= g_max_idle) {
+            g_free[buf->size].push_back(buf->data);
+            g_stats.idle_bytes += buf->size;
+            buf->data = nullptr;
+        }
+    }
+    std::free(buf->data);
+    delete buf;
+}
+
+cairo_surface_t* surface_pool_acquire(int width, int height, bool clear) {
+    if (width <= 0 || height <= 0) return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+
+    const int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+    const size_t bytes = (size_t)stride * height;
+    const size_t cls = size_class(bytes);
+
+    void* data = nullptr;
+    bool fresh = false;
+    {
+        std::lock_guard<std::mutex> lk(g_mutex);
+        auto it = g_free.find(cls);
+        if (it != g_free.end() && !it->second.empty()) {
+            data = it->second.back();
+            it->second.pop_back();
+            g_stats.idle_bytes -= cls;
+            ++g_stats.hits;
+        } else {
+            ++g_stats.misses;
+        }
+        if (data) {
+            g_stats.in_use_bytes += cls;
+            update_peak_locked();
+        }
+    }
+
+    if (!data) {
+        data = std::aligned_alloc(class_align(cls), cls);
+        if (!data) return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+        fresh = true;
+        std::lock_guard<std::mutex> lk(g_mutex);
+        g_stats.in_use_bytes += cls;
+        update_peak_locked();
+    }
+
+    // Writing every page of a fresh buffer pre-faults it; reused ones only need it when asked
+    if (fresh) std::memset(data, 0, cls);
+    else if (clear) std::memset(data, 0, bytes);
+
+    cairo_surface_t* s = cairo_image_surface_create_for_data(
+        static_cast<unsigned char*>(data), CAIRO_FORMAT_ARGB32, width, height, stride);
+    PooledBuffer* buf = new PooledBuffer{ data, cls };
+    if (cairo_surface_status(s) != CAIRO_STATUS_SUCCESS ||
+        cairo_surface_set_user_data(s, &g_pool_key, buf, release_buffer) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(s);
+        release_buffer(buf);
+        return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    }
+    return s;
+}
+
+SurfacePoolStats surface_pool_stats() {
+    std::lock_guard<std::mutex> lk(g_mutex);
+    return g_stats;
+}
+
+void surface_pool_set_max_idle_bytes(size_t bytes) {
+    std::lock_guard<std::mutex> lk(g_mutex);
+    g_max_idle = bytes;
+    g_max_idle_init = true;
+}
+
+void surface_pool_trim() {
+    std::lock_guard<std::mutex> lk(g_mutex);
+    for (auto& kv : g_free)
+        for (void* p : kv.second) std::free(p);
+    g_free.clear();
+    g_stats.idle_bytes = 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cairo.h>
+
+// Pool of pre-faulted ARGB32 pixel buffers bucketed by size class (4 KB and up,
+// page aligned from 64 KB).
+// Surfaces from surface_pool_acquire() are ordinary cairo image surfaces; when the
+// last reference is dropped (cairo_surface_destroy) the buffer goes back to the pool
+// instead of the allocator, so per-frame canvases and glyphs stop faulting in pages.
+
+// New ARGB32 surface backed by a pooled buffer. Pixels are zeroed unless
+// clear is false (use that when the caller overwrites every pixel anyway).
+// Falls back to cairo_image_surface_create if the pool cannot allocate.
+cairo_surface_t* surface_pool_acquire(int width, int height, bool clear = true);
+
+struct SurfacePoolStats {
+    size_t in_use_bytes = 0;   // handed out, not yet released
+    size_t idle_bytes   = 0;   // held in free lists
+    size_t peak_bytes   = 0;   // max of in_use + idle
+    size_t hits   = 0;         // acquires served from a free list
+    size_t misses = 0;         // acquires that had to allocate
+};
+
+SurfacePoolStats surface_pool_stats();
+
+// Cap on idle bytes kept for reuse; released buffers beyond it are freed.
+// Defaults to $SURFACE_POOL_MAX_MB, else 256 MB.
+void surface_pool_set_max_idle_bytes(size_t bytes);
+
+// Free every idle buffer.
+void surface_pool_trim();
@@ -0,0 +1,132 @@
+// Surface pool bookkeeping: buffers are rounded up to the expected size class, rows
+// use cairo's own stride and buffers their class alignment, a buffer comes back for
+// reuse only once the last cairo reference is dropped, and the idle cap and trim
+// free what the pool must not keep.
+// Build: g++ -O2 -std=c++17 surface_pool_test.cpp surface_pool.cpp $(pkg-config --cflags --libs cairo)
+//        -o surface_pool_test
+#include "surface_pool.hpp"
+#include <cairo.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static int g_failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    if (ok) return;
+    ++g_failures;
+    if (g_failures <= 20) std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+}
+
+// Reference classes: 4 KB, then x1.25, x1.5, x1.75 and x2 of each power of two
+static size_t expected_class(size_t bytes) {
+    if (bytes <= 4096) return 4096;
+    for (size_t pow2 = 4096;; pow2 *= 2)
+        for (size_t q = 5; q <= 8; ++q)
+            if (pow2 / 4 * q >= bytes) return pow2 / 4 * q;
+}
+
+static size_t bytes_for(int w, int h) {
+    return (size_t)cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, w) * h;
+}
+
+static std::string dims(int w, int h) {
+    return std::to_string(w) + "x" + std::to_string(h);
+}
+
+int main() {
+    surface_pool_set_max_idle_bytes(256u << 20);
+    surface_pool_trim();
+
+    // ---- Size classes, stride and alignment ----
+    const int sizes[][2] = { { 1, 1 }, { 32, 32 }, { 33, 32 }, { 7, 13 }, { 100, 100 }, { 127, 129 },
+                             { 128, 128 }, { 129, 128 }, { 300, 200 }, { 1920, 1080 }, { 3, 4000 } };
+    for (const auto& wh : sizes) {
+        const int w = wh[0], h = wh[1];
+        const SurfacePoolStats before = surface_pool_stats();
+        cairo_surface_t* s = surface_pool_acquire(w, h);
+        const SurfacePoolStats after = surface_pool_stats();
+        const size_t bytes = bytes_for(w, h), cls = expected_class(bytes);
+
+        check(cairo_surface_status(s) == CAIRO_STATUS_SUCCESS && cairo_image_surface_get_width(s) == w &&
+              cairo_image_surface_get_height(s) == h && cairo_image_surface_get_format(s) == CAIRO_FORMAT_ARGB32,
+              dims(w, h) + ": surface");
+        check(after.in_use_bytes - before.in_use_bytes == cls, dims(w, h) + ": size class");
+        check(bytes <= 4096 || cls * 4 <= bytes * 5, dims(w, h) + ": at most 25% slack");
+        check(cairo_image_surface_get_stride(s) == cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, w),
+              dims(w, h) + ": stride");
+        const uintptr_t addr = (uintptr_t)cairo_image_surface_get_data(s);
+        check(addr % (cls >= 64 * 1024 ? 4096 : 64) == 0, dims(w, h) + ": alignment");
+
+        bool zero = true;
+        const unsigned char* data = cairo_image_surface_get_data(s);
+        for (size_t i = 0; i < bytes && zero; ++i) zero = data[i] == 0;
+        check(zero, dims(w, h) + ": fresh buffer is cleared");
+        cairo_surface_destroy(s);
+    }
+    surface_pool_trim();
+    check(surface_pool_stats().idle_bytes == 0 && surface_pool_stats().in_use_bytes == 0,
+          "trim frees every idle buffer");
+
+    // ---- Reuse through the cairo user-data hook ----
+    {
+        cairo_surface_t* a = surface_pool_acquire(100, 100);
+        unsigned char* buffer = cairo_image_surface_get_data(a);
+        std::memset(buffer, 0xab, bytes_for(100, 100));
+        cairo_surface_mark_dirty(a);
+
+        // Still referenced elsewhere (e.g. a cache): not back in the pool yet
+        cairo_surface_reference(a);
+        cairo_surface_destroy(a);
+        check(surface_pool_stats().idle_bytes == 0, "buffer held while a reference remains");
+        cairo_surface_destroy(a);
+        check(surface_pool_stats().idle_bytes == expected_class(bytes_for(100, 100)),
+              "buffer idle once the last reference is dropped");
+
+        // 90x110 falls in the same class as 100x100 and gets the same buffer, cleared
+        const SurfacePoolStats before = surface_pool_stats();
+        cairo_surface_t* b = surface_pool_acquire(90, 110);
+        const SurfacePoolStats after = surface_pool_stats();
+        check(cairo_image_surface_get_data(b) == buffer, "same-class acquire reuses the buffer");
+        check(after.hits == before.hits + 1 && after.misses == before.misses && after.idle_bytes == 0,
+              "reuse counted as a hit");
+        bool zero = true;
+        for (size_t i = 0; i < bytes_for(90, 110) && zero; ++i) zero = buffer[i] == 0;
+        check(zero, "reused buffer is cleared");
+        cairo_surface_destroy(b);
+
+        // A different class does not take it
+        cairo_surface_t* c = surface_pool_acquire(200, 200);
+        check(cairo_image_surface_get_data(c) != buffer && surface_pool_stats().idle_bytes > 0,
+              "other classes allocate their own buffer");
+        cairo_surface_destroy(c);
+        check(surface_pool_stats().peak_bytes >= surface_pool_stats().idle_bytes, "peak covers idle");
+    }
+    surface_pool_trim();
+
+    // ---- Idle cap ----
+    {
+        const size_t cls = expected_class(bytes_for(100, 100));
+        surface_pool_set_max_idle_bytes(cls);
+        cairo_surface_t* a = surface_pool_acquire(100, 100);
+        cairo_surface_t* b = surface_pool_acquire(100, 100);
+        check(surface_pool_stats().in_use_bytes == 2 * cls, "two buffers in use");
+        cairo_surface_destroy(a);
+        cairo_surface_destroy(b);
+        check(surface_pool_stats().idle_bytes == cls && surface_pool_stats().in_use_bytes == 0,
+              "buffers beyond the idle cap are freed");
+
+        surface_pool_set_max_idle_bytes(0);
+        surface_pool_trim();
+        cairo_surface_destroy(surface_pool_acquire(100, 100));
+        check(surface_pool_stats().idle_bytes == 0, "a zero cap keeps nothing");
+    }
+
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("surface_pool: size classes, reuse and idle cap as expected\n");
+    return 0;
+}
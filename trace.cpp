@@ -0,0 +1,218 @@
+#include "trace.hpp"
+
+#ifdef RENDER_TRACE
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Per-thread event buffers are capped; histograms keep counting past the cap.
+static const size_t kMaxEventsPerThread = 1u << 18;
+
+// Log-scale latency buckets: 8 sub-buckets per power of two (~9% resolution)
+static const int kSubBuckets = 8;
+static const int kBuckets = 64 * kSubBuckets;
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t dur_ns;
+    uint64_t bytes;
+};
+
+struct StageStats {
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t bytes = 0;
+    std::array<uint32_t, kBuckets> hist{};
+};
+
+struct ThreadBuffer {
+    int tid = 0;
+    std::mutex mutex;  // only contended while a dump is running
+    std::vector<TraceEvent> events;
+    uint64_t dropped = 0;
+    std::unordered_map<const char*, StageStats> stats;
+};
+
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> threads;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+// Leaked on purpose: worker threads may still record during static destruction
+static TraceRegistry& registry() {
+    static TraceRegistry* r = new TraceRegistry();
+    return *r;
+}
+
+static uint64_t now_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - registry().epoch).count();
+}
+
+static ThreadBuffer& thread_buffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buf;
+    if (!buf) {
+        buf = std::make_shared<ThreadBuffer>();
+        buf->events.reserve(4096);
+        TraceRegistry& r = registry();
+        std::lock_guard<std::mutex> lk(r.mutex);
+        buf->tid = (int)r.threads.size() + 1;
+        r.threads.push_back(buf);
+    }
+    return *buf;
+}
+
+static thread_local TraceScope* t_current = nullptr;
+
+static int bucket_for(uint64_t ns) {
+    if (ns < kSubBuckets) return (int)ns;
+    int msb = 63 - __builtin_clzll(ns);
+    int sub = (int)((ns >> (msb - 3)) & (kSubBuckets - 1));
+    return std::min(msb * kSubBuckets + sub, kBuckets - 1);
+}
+
+// Midpoint of a bucket's range, in ns
+static double bucket_value(int b) {
+    if (b < kSubBuckets) return b;
+    int msb = b / kSubBuckets, sub = b % kSubBuckets;
+    double lo = std::ldexp((double)(kSubBuckets + sub), msb - 3);
+    return lo + std::ldexp(0.5, msb - 3);
+}
+
+static double percentile_ns(const StageStats& s, double q) {
+    uint64_t target = (uint64_t)(q * (double)(s.count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < kBuckets; ++b) {
+        seen += s.hist[b];
+        if (seen >= target) return bucket_value(b);
+    }
+    return 0.0;
+}
+
+// ---------- scopes ----------
+TraceScope::TraceScope(const char* name)
+    : name_(name), start_ns_(now_ns()), parent_(t_current) {
+    t_current = this;
+}
+
+TraceScope::~TraceScope() {
+    uint64_t dur = now_ns() - start_ns_;
+    t_current = parent_;
+
+    ThreadBuffer& buf = thread_buffer();
+    std::lock_guard<std::mutex> lk(buf.mutex);
+    if (buf.events.size() < kMaxEventsPerThread)
+        buf.events.push_back({name_, start_ns_, dur, bytes_});
+    else
+        ++buf.dropped;
+
+    StageStats& s = buf.stats[name_];
+    ++s.count;
+    s.total_ns += dur;
+    s.bytes += bytes_;
+    ++s.hist[bucket_for(dur)];
+}
+
+void TraceScope::addBytesToCurrent(uint64_t n) {
+    if (t_current) t_current->addBytes(n);
+}
+
+// ---------- output ----------
+static std::string json_escape(const char* s) {
+    std::string out;
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') out += '\\';
+        out += *s;
+    }
+    return out;
+}
+
+bool trace_write_chrome_json(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Cannot write trace file " << path << "\n";
+        return false;
+    }
+
+    TraceRegistry& r = registry();
+    std::lock_guard<std::mutex> rlk(r.mutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    char line[512];
+    for (auto& t : r.threads) {
+        std::lock_guard<std::mutex> lk(t->mutex);
+        for (const TraceEvent& e : t->events) {
+            // Complete ("X") events; timestamps are microseconds
+            std::snprintf(line, sizeof(line),
+                          "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                          "\"args\":{\"bytes\":%llu}}",
+                          first ? "" : ",\n", json_escape(e.name).c_str(), t->tid,
+                          e.start_ns / 1000.0, e.dur_ns / 1000.0, (unsigned long long)e.bytes);
+            out << line;
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
+
+void trace_print_summary(std::ostream& out) {
+    std::map<std::string, StageStats> merged;
+    uint64_t dropped = 0;
+    {
+        TraceRegistry& r = registry();
+        std::lock_guard<std::mutex> rlk(r.mutex);
+        for (auto& t : r.threads) {
+            std::lock_guard<std::mutex> lk(t->mutex);
+            dropped += t->dropped;
+            for (auto& kv : t->stats) {
+                StageStats& m = merged[kv.first];
+                m.count += kv.second.count;
+                m.total_ns += kv.second.total_ns;
+                m.bytes += kv.second.bytes;
+                for (int b = 0; b < kBuckets; ++b) m.hist[b] += kv.second.hist[b];
+            }
+        }
+    }
+    if (merged.empty()) return;
+
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-24s %8s %10s %10s %12s %10s %9s\n",
+                  "stage", "count", "p50 ms", "p99 ms", "total ms", "MB", "MB/s");
+    out << line;
+    for (auto& kv : merged) {
+        const StageStats& s = kv.second;
+        double total_ms = s.total_ns / 1e6;
+        double mb = s.bytes / (1024.0 * 1024.0);
+        std::snprintf(line, sizeof(line), "%-24s %8llu %10.3f %10.3f %12.2f %10.2f %9.1f\n",
+                      kv.first.c_str(), (unsigned long long)s.count,
+                      percentile_ns(s, 0.50) / 1e6, percentile_ns(s, 0.99) / 1e6, total_ms, mb,
+                      total_ms > 0 ? mb / (total_ms / 1000.0) : 0.0);
+        out << line;
+    }
+    if (dropped) out << "(" << dropped << " events beyond the per-thread cap left out of the trace file)\n";
+}
+
+// Dump on normal process exit
+static struct TraceAtExit {
+    ~TraceAtExit() {
+        const char* path = std::getenv("RENDER_TRACE_FILE");
+        trace_write_chrome_json(path && *path ? path : "render_trace.json");
+        trace_print_summary(std::cerr);
+    }
+} g_trace_at_exit;
+
+#endif
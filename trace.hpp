@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Scoped per-stage tracing. Compiled out unless built with -DRENDER_TRACE
+// (cmake -DRENDER_TRACE=ON).
+//
+//   void render() {
+//       TRACE_SCOPE("svg.rasterize");
+//       ...
+//       TRACE_BYTES(w * h * 4);   // attributed to the innermost open scope
+//   }
+//
+// With RENDER_TRACE the process writes a Chrome trace-event file on exit
+// ($RENDER_TRACE_FILE, default render_trace.json; load it in chrome://tracing or
+// Perfetto) and prints per-stage count / p50 / p99 / bytes to stderr.
+// Stage names must be string literals (the pointer is the key).
+
+#ifdef RENDER_TRACE
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    void addBytes(uint64_t n) { bytes_ += n; }
+    static void addBytesToCurrent(uint64_t n);
+
+private:
+    const char* name_;
+    uint64_t start_ns_;
+    uint64_t bytes_ = 0;
+    TraceScope* parent_;
+};
+
+// Write everything recorded so far; both are also run automatically at exit
+bool trace_write_chrome_json(const std::string& path);
+void trace_print_summary(std::ostream& out);
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_BYTES(n) TraceScope::addBytesToCurrent((uint64_t)(n))
+
+#else
+
+inline bool trace_write_chrome_json(const std::string&) { return false; }
+inline void trace_print_summary(std::ostream&) {}
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_BYTES(n) ((void)0)
+
+#endif
@@ -0,0 +1,158 @@
+// Log-bucket latency histogram and Chrome trace output: every duration must land in
+// a bucket whose midpoint is within its ~6% resolution, percentiles must come out
+// of the right bucket, and the trace file must be one well-formed "X" event per
+// closed scope, nested scopes inside their parent. Includes trace.cpp directly to
+// reach the bucket helpers.
+// Build: g++ -O2 -std=c++17 trace_test.cpp -pthread -o trace_test
+#define RENDER_TRACE
+#include "trace.cpp"
+
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+static int g_failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    if (ok) return;
+    ++g_failures;
+    if (g_failures <= 20) std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+}
+
+static bool near(double got, double want, double rel) {
+    return std::fabs(got - want) <= rel * want;
+}
+
+struct Event {
+    std::string name;
+    int tid = 0;
+    double ts = 0, dur = 0;
+    unsigned long long bytes = 0;
+};
+
+// One event per line, comma-terminated but for the last, as
+// trace_write_chrome_json lays them out
+static bool parse_event(std::string line, Event& e) {
+    if (!line.empty() && line.back() == ',') line.pop_back();
+    char name[128];
+    if (std::sscanf(line.c_str(), "{\"name\":\"%127[^\"]\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lf,\"dur\":%lf,"
+                       "\"args\":{\"bytes\":%llu}}",
+                    name, &e.tid, &e.ts, &e.dur, &e.bytes) != 5)
+        return false;
+    e.name = name;
+    return line.size() > 2 && line.compare(line.size() - 2, 2, "}}") == 0;
+}
+
+int main() {
+    // Whatever the exit hook dumps is not wanted
+    setenv("RENDER_TRACE_FILE", "/dev/null", 1);
+
+    // ---- Buckets ----
+    for (uint64_t ns = 0; ns < kSubBuckets; ++ns)
+        check(bucket_value(bucket_for(ns)) == (double)ns, "exact bucket for " + std::to_string(ns));
+    int last = -1;
+    for (uint64_t ns = 1; ns < (1ull << 40); ns += ns / 7 + 1) {
+        const int b = bucket_for(ns);
+        check(b >= last, "buckets are monotonic at " + std::to_string(ns));
+        check(near(bucket_value(b), (double)ns, 1.0 / 16), "bucket midpoint for " + std::to_string(ns));
+        last = b;
+    }
+    check(bucket_for(~0ull) == kBuckets - 1, "largest duration in the last bucket");
+
+    // ---- Percentiles ----
+    {
+        StageStats s;
+        for (uint64_t us = 1; us <= 1000; ++us) {   // 1 us .. 1 ms, uniform
+            ++s.count;
+            ++s.hist[bucket_for(us * 1000)];
+        }
+        check(near(percentile_ns(s, 0.50), 500e3, 1.0 / 16), "p50 of a uniform spread");
+        check(near(percentile_ns(s, 0.99), 990e3, 1.0 / 16), "p99 of a uniform spread");
+        check(near(percentile_ns(s, 0.0), 1e3, 1.0 / 16), "p0 is the minimum");
+        check(near(percentile_ns(s, 1.0), 1000e3, 1.0 / 16), "p100 is the maximum");
+    }
+    {
+        StageStats s;   // 98 fast, 2 slow: p50 fast, p99 slow
+        for (int i = 0; i < 98; ++i) { ++s.count; ++s.hist[bucket_for(20000)]; }
+        for (int i = 0; i < 2; ++i) { ++s.count; ++s.hist[bucket_for(40000000)]; }
+        check(near(percentile_ns(s, 0.50), 20000, 1.0 / 16), "p50 with an outlier tail");
+        check(near(percentile_ns(s, 0.99), 40000000, 1.0 / 16), "p99 with an outlier tail");
+    }
+
+    // ---- Chrome trace JSON ----
+    auto work = [](int n) {
+        for (int i = 0; i < n; ++i) {
+            TRACE_SCOPE("test.outer");
+            TRACE_BYTES(100);
+            {
+                TRACE_SCOPE("test.inner");
+                TRACE_BYTES(7);
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    };
+    std::thread t1(work, 3), t2(work, 2);
+    t1.join();
+    t2.join();
+    {
+        TRACE_SCOPE("test.\"quoted\"");
+    }
+
+    const fs::path path = fs::temp_directory_path() / "trace_test.json";
+    check(trace_write_chrome_json(path.string()), "write trace file");
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    check(line == "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", "trace header");
+
+    std::vector<Event> events;
+    bool closed = false;
+    while (std::getline(in, line)) {
+        if (line == "]}") { closed = true; break; }
+        Event e;
+        if (line.find("quoted") != std::string::npos) {
+            check(line.find("\"name\":\"test.\\\"quoted\\\"\"") != std::string::npos, "name is escaped");
+            continue;
+        }
+        check(parse_event(line, e), "event line: " + line);
+        events.push_back(e);
+    }
+    check(closed && !std::getline(in, line), "trace footer");
+    in.close();
+    fs::remove(path);
+
+    size_t outer = 0, inner = 0;
+    for (const Event& e : events) {
+        if (e.name == "test.outer") {
+            ++outer;
+            check(e.bytes == 100, "outer scope bytes");
+        } else if (e.name == "test.inner") {
+            ++inner;
+            check(e.bytes == 7, "inner scope bytes");
+            check(e.dur >= 50, "inner duration covers the sleep");
+            bool inside = false;   // within an outer event on the same thread (to the printed 1 ns)
+            for (const Event& o : events)
+                inside |= o.name == "test.outer" && o.tid == e.tid && o.ts <= e.ts &&
+                          e.ts + e.dur <= o.ts + o.dur + 0.002;
+            check(inside, "inner nested in outer");
+        }
+    }
+    check(outer == 5 && inner == 5, "one event per closed scope");
+
+    std::ostringstream summary;
+    trace_print_summary(summary);
+    const std::string text = summary.str();
+    check(text.compare(0, 5, "stage") == 0, "summary header");
+    check(text.find("test.inner") != std::string::npos && text.find("test.outer") != std::string::npos,
+          "summary lists every stage");
+
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("trace: buckets, percentiles and trace file as expected\n");
+    return 0;
+}